@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crawler.h"
+
+using namespace std;
+
+// One front end for every traversal engine in ../crawlercommon/crawler.h, over
+// the live service, a neighbor cache or a local CSR graph file.
+
+void usage(const char* prog) {
+    cerr << "Usage: " << prog << " <node_name> <depth> [--engine " << engine_names() << "] [--threads <n>]\n"
+         << "       [--graph <file.csr>] " << CacheOptions::usage() << "\n"
+         << "       " << FetchOptions::usage() << " " << TelemetryOptions::usage() << "\n"
+         << "       " << OutputOptions::usage() << "\n"
+         << "       level and multi engines: " << CheckpointOptions::usage() << "\n"
+         << "       " << LimitOptions::usage() << " [--export-csr <graph.csr>]\n"
+         << "       multi engine: [--multi <max_in_flight>] [--loops <1|2>]\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    string start_node = argv[1];
+    int depth;
+    string engine_name = "level";
+    int thread_count = std::max(1u, thread::hardware_concurrency());
+    string graph_path;
+    string csr_path; // write the crawled subgraph here
+    EngineConfig config;
+    CacheOptions cache_options;
+    FetchOptions fetch_options;
+    TelemetryOptions telemetry_options;
+    OutputOptions output_options;
+    CheckpointOptions checkpoint_options;
+    LimitOptions limit_options;
+    try {
+        depth = stoi(argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            if (cache_options.parse(argc, argv, i) || fetch_options.parse(argc, argv, i) ||
+                telemetry_options.parse(argc, argv, i) || output_options.parse(argc, argv, i) ||
+                checkpoint_options.parse(argc, argv, i) || limit_options.parse(argc, argv, i))
+                continue;
+            string opt = argv[i];
+            if (opt == "--engine" && i + 1 < argc) {
+                engine_name = argv[++i];
+            } else if (opt == "--threads" && i + 1 < argc) {
+                thread_count = stoi(argv[++i]);
+            } else if (opt == "--graph" && i + 1 < argc) {
+                graph_path = argv[++i];
+            } else if (opt == "--export-csr" && i + 1 < argc) {
+                csr_path = argv[++i];
+            } else if (opt == "--multi" && i + 1 < argc) {
+                engine_name = "multi";
+                config.max_in_flight = stoi(argv[++i]);
+            } else if (opt == "--loops" && i + 1 < argc) {
+                config.loops = stoi(argv[++i]);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: Depth, thread count and option values must be numbers, --format one of text, ndjson, binary,\n"
+             << "--priority one of degree, none.\n";
+        return 1;
+    }
+
+    StringInterner names;
+    unique_ptr<NeighborCache> cache;
+    unique_ptr<OutputSink> sink;
+    unique_ptr<CsrGraph> graph;
+    unique_ptr<CrawlCheckpoint> checkpoint;
+    CrawlState resumed; // empty: start from scratch
+    unique_ptr<EdgeList> edges;
+    unique_ptr<Telemetry> telemetry = telemetry_options.open();
+    unique_ptr<CrawlLimits> limits;
+    unique_ptr<FrontierPriority> priority = limit_options.open_priority();
+    unique_ptr<TraversalEngine> engine;
+    try {
+        cache = cache_options.open();
+        sink = output_options.open();
+        if (!graph_path.empty())
+            graph = make_unique<CsrGraph>(graph_path);
+        checkpoint = checkpoint_options.open();
+        if (!csr_path.empty()) {
+            if (checkpoint_options.resume)
+                throw runtime_error("--export-csr needs the whole crawl and can't be combined with --resume");
+            edges = make_unique<EdgeList>();
+        }
+        resumed = checkpoint_options.resumed(checkpoint.get(), start_node, names);
+        // the deadline counts from here
+        limits = limit_options.open();
+        config.threads = thread_count;
+        config.telemetry = telemetry.get();
+        config.sink = sink.get();
+        config.checkpoint = checkpoint.get();
+        if (checkpoint_options.resume)
+            config.resume = &resumed;
+        config.edges = edges.get();
+        config.limits = limits.get();
+        config.priority = priority.get();
+        engine = make_engine(engine_name, config);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    FetchScope fetch(fetch_options, telemetry.get());
+    const auto start = std::chrono::steady_clock::now(); // start timing
+
+    vector<vector<NodeId>> levels;
+    try {
+        unique_ptr<NeighborSource> source;
+        if (graph)
+            source = make_unique<CsrSource>(*graph);
+        else
+            source = make_unique<HttpSource>(fetch.context(), limits.get());
+        unique_ptr<NeighborSource> cached;
+        if (cache)
+            cached = make_unique<CachedSource>(*cache, source.get());
+        levels = engine->crawl(cached ? *cached : *source, names, start_node, depth);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        if (checkpoint)
+            cerr << "Progress is saved in " << checkpoint->file() << "; rerun with --resume to continue\n";
+        return 1;
+    }
+
+    double seconds = report_crawl(levels, names, sink.get(), limits.get(), start);
+    if (cache)
+        cerr << "Neighbor cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    fetch.rate().report(cerr);
+    if (edges)
+        export_edges(*edges, csr_path, names);
+    try {
+        telemetry_options.finish(telemetry.get(), seconds);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+    }
+    return 0;
+}
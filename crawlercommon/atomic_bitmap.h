@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "string_interner.h"
+
+// Visited flags indexed by NodeId. Words live in fixed-size segments allocated
+// on first touch, so the bitmap covers the whole id space, grows with the
+// crawl and never moves a word another thread may be updating.
+class AtomicBitmap {
+public:
+    AtomicBitmap() : segments(new std::atomic<std::atomic<uint64_t>*>[SEGMENTS]) {
+        for (size_t s = 0; s < SEGMENTS; ++s)
+            segments[s].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~AtomicBitmap() {
+        for (size_t s = 0; s < SEGMENTS; ++s)
+            delete[] segments[s].load(std::memory_order_relaxed);
+    }
+
+    AtomicBitmap(const AtomicBitmap&) = delete;
+    AtomicBitmap& operator=(const AtomicBitmap&) = delete;
+
+    // set the bit; true if it was clear, i.e. this caller got there first
+    bool test_and_set(NodeId id) {
+        uint64_t mask = uint64_t(1) << (id & 63);
+        return !(word(id).fetch_or(mask, std::memory_order_acq_rel) & mask);
+    }
+
+    bool test(NodeId id) const {
+        std::atomic<uint64_t>* seg = segments[id >> SEGMENT_BITS].load(std::memory_order_acquire);
+        return seg && (seg[(id & SEGMENT_MASK) >> 6].load(std::memory_order_acquire) >> (id & 63)) & 1;
+    }
+
+private:
+    static const unsigned SEGMENT_BITS = 20; // 1M ids, 128 KiB per segment
+    static const NodeId SEGMENT_MASK = (1u << SEGMENT_BITS) - 1;
+    static const size_t SEGMENTS = size_t(1) << (32 - SEGMENT_BITS);
+    static const size_t SEGMENT_WORDS = (size_t(1) << SEGMENT_BITS) / 64;
+
+    std::atomic<uint64_t>& word(NodeId id) {
+        std::atomic<std::atomic<uint64_t>*>& slot = segments[id >> SEGMENT_BITS];
+        std::atomic<uint64_t>* seg = slot.load(std::memory_order_acquire);
+        if (!seg) {
+            std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[SEGMENT_WORDS];
+            for (size_t w = 0; w < SEGMENT_WORDS; ++w)
+                fresh[w].store(0, std::memory_order_relaxed);
+            if (slot.compare_exchange_strong(seg, fresh, std::memory_order_acq_rel))
+                seg = fresh;
+            else
+                delete[] fresh; // another thread installed it first; seg now holds theirs
+        }
+        return seg[(id & SEGMENT_MASK) >> 6];
+    }
+
+    std::unique_ptr<std::atomic<std::atomic<uint64_t>*>[]> segments;
+};
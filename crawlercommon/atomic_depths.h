@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+
+#include "string_interner.h"
+
+// BFS depth per NodeId, lowered with a CAS so concurrent workers can each
+// offer a depth and the smallest wins. Laid out like AtomicBitmap: fixed-size
+// segments allocated on first touch, never moved once another thread can see
+// them.
+class AtomicDepths {
+public:
+    static const int UNSEEN = INT_MAX;
+
+    AtomicDepths() : segments(new std::atomic<std::atomic<int>*>[SEGMENTS]) {
+        for (size_t s = 0; s < SEGMENTS; ++s)
+            segments[s].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~AtomicDepths() {
+        for (size_t s = 0; s < SEGMENTS; ++s)
+            delete[] segments[s].load(std::memory_order_relaxed);
+    }
+
+    AtomicDepths(const AtomicDepths&) = delete;
+    AtomicDepths& operator=(const AtomicDepths&) = delete;
+
+    // set id's depth to depth if that is smaller; true if it was (or id was unseen)
+    bool lower(NodeId id, int depth) {
+        std::atomic<int>& slot = entry(id);
+        int current = slot.load(std::memory_order_acquire);
+        while (depth < current)
+            if (slot.compare_exchange_weak(current, depth, std::memory_order_acq_rel))
+                return true;
+        return false;
+    }
+
+    int get(NodeId id) const {
+        std::atomic<int>* seg = segments[id >> SEGMENT_BITS].load(std::memory_order_acquire);
+        return seg ? seg[id & SEGMENT_MASK].load(std::memory_order_acquire) : UNSEEN;
+    }
+
+private:
+    static const unsigned SEGMENT_BITS = 16; // 64K ids, 256 KiB per segment
+    static const NodeId SEGMENT_MASK = (1u << SEGMENT_BITS) - 1;
+    static const size_t SEGMENTS = size_t(1) << (32 - SEGMENT_BITS);
+    static const size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+
+    std::atomic<int>& entry(NodeId id) {
+        std::atomic<std::atomic<int>*>& slot = segments[id >> SEGMENT_BITS];
+        std::atomic<int>* seg = slot.load(std::memory_order_acquire);
+        if (!seg) {
+            std::atomic<int>* fresh = new std::atomic<int>[SEGMENT_SIZE];
+            for (size_t i = 0; i < SEGMENT_SIZE; ++i)
+                fresh[i].store(UNSEEN, std::memory_order_relaxed);
+            if (slot.compare_exchange_strong(seg, fresh, std::memory_order_acq_rel))
+                seg = fresh;
+            else
+                delete[] fresh; // another thread installed it first; seg now holds theirs
+        }
+        return seg[id & SEGMENT_MASK];
+    }
+
+    std::unique_ptr<std::atomic<std::atomic<int>*>[]> segments;
+};
@@ -0,0 +1,126 @@
+// Contention microbenchmark for the crawlers' visited-set update.
+//
+// Every thread replays synthetic neighbor lists (mostly small, some large
+// movie casts, names drawn with a heavy skew towards hub nodes) through:
+//   global-mutex    unordered_set<string> under one visited_mutex, pushing new
+//                   names under a nested level_mutex (the original scheme)
+//   sharded-set     ShardedSet<string>::insert, new names kept per thread
+//   intern+bitmap   StringInterner + AtomicBitmap, as the crawlers do now
+//
+// Usage: ./visited_bench [max_threads] [responses_per_thread]
+// Prints CSV: scheme,threads,inserts,seconds,Minserts_per_s
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "atomic_bitmap.h"
+#include "sharded_map.h"
+#include "string_interner.h"
+
+using namespace std;
+
+using Responses = vector<vector<string>>;
+
+vector<Responses> make_workload(int threads, int responses, size_t universe) {
+    vector<Responses> work(threads);
+    for (int t = 0; t < threads; ++t) {
+        mt19937 gen(1234 + t);
+        uniform_real_distribution<double> u(0., 1.);
+        for (int r = 0; r < responses; ++r) {
+            // 1 in 50 responses is a hub with a large cast
+            size_t n = u(gen) < 0.02 ? 400 + gen() % 400 : 5 + gen() % 20;
+            vector<string> names;
+            names.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                size_t k = size_t(pow(u(gen), 3.) * universe);
+                names.push_back("Node " + to_string(k));
+            }
+            work[t].push_back(std::move(names));
+        }
+    }
+    return work;
+}
+
+template <class Body>
+double run(int threads, Body body) {
+    vector<thread> pool;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back(body, t);
+    for (auto& th : pool)
+        th.join();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? stoi(argv[1]) : int(thread::hardware_concurrency());
+    int responses = argc > 2 ? stoi(argv[2]) : 20000;
+    const size_t universe = 200000;
+
+    vector<Responses> work = make_workload(max_threads, responses, universe);
+
+    cout << "scheme,threads,inserts,seconds,Minserts_per_s\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        size_t inserts = 0;
+        for (int t = 0; t < threads; ++t)
+            for (const auto& r : work[t])
+                inserts += r.size();
+
+        auto report = [&](const char* scheme, double secs) {
+            cout << scheme << "," << threads << "," << inserts << "," << secs << "," << inserts / secs / 1e6 << "\n";
+        };
+
+        {
+            unordered_set<string> visited;
+            vector<string> next_level;
+            mutex visited_mutex, level_mutex;
+            report("global-mutex", run(threads, [&](int t) {
+                for (const auto& r : work[t])
+                    for (const auto& name : r) {
+                        lock_guard<mutex> guard1(visited_mutex);
+                        if (!visited.count(name)) {
+                            visited.insert(name);
+                            lock_guard<mutex> guard2(level_mutex);
+                            next_level.push_back(name);
+                        }
+                    }
+            }));
+        }
+
+        {
+            ShardedSet<string> visited;
+            vector<vector<string>> found(threads);
+            report("sharded-set", run(threads, [&](int t) {
+                for (const auto& r : work[t])
+                    for (const auto& name : r)
+                        if (visited.insert(name))
+                            found[t].push_back(name);
+            }));
+        }
+
+        {
+            StringInterner names;
+            AtomicBitmap visited;
+            vector<vector<NodeId>> found(threads);
+            report("intern+bitmap", run(threads, [&](int t) {
+                for (const auto& r : work[t])
+                    for (const auto& name : r) {
+                        NodeId id = names.intern(name);
+                        if (visited.test_and_set(id))
+                            found[t].push_back(id);
+                    }
+            }));
+        }
+
+        if (threads < max_threads && threads * 2 > max_threads)
+            threads = max_threads / 2; // make sure max_threads itself is measured
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = {'C', 'R', 'A', 'W', 'L', 'C', 'K', 'P'};
+const uint32_t VERSION = 1;
+
+void put_u32(string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+void put_string(string& out, const string& s) {
+    put_u32(out, s.size());
+    out += s;
+}
+
+uint64_t fnv1a(const char* data, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// bounds-checked reads over a loaded snapshot
+class Reader {
+public:
+    Reader(const string& bytes, size_t end) : bytes(bytes), end(end) {}
+
+    uint32_t u32() {
+        uint32_t v;
+        memcpy(&v, take(sizeof v), sizeof v);
+        return v;
+    }
+    string str() {
+        uint32_t n = u32();
+        return string(take(n), n);
+    }
+    const char* take(size_t n) {
+        if (n > end - pos)
+            throw runtime_error("Truncated checkpoint");
+        const char* p = bytes.data() + pos;
+        pos += n;
+        return p;
+    }
+    bool done() const { return pos == end; }
+
+private:
+    const string& bytes;
+    size_t end;
+    size_t pos = 0;
+};
+
+bool write_all(int fd, const string& bytes) {
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+} // namespace
+
+CrawlCheckpoint::CrawlCheckpoint(const string& path, double interval_seconds)
+    : path(path), interval_ms(int64_t(interval_seconds * 1000)), next_due(now_ms() + interval_ms) {}
+
+int64_t CrawlCheckpoint::now_ms() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CrawlCheckpoint::due() {
+    int64_t now = now_ms();
+    int64_t next = next_due.load(memory_order_relaxed);
+    return now >= next && next_due.compare_exchange_strong(next, now + interval_ms);
+}
+
+bool CrawlCheckpoint::load(const string& start, StringInterner& names, CrawlState& state) const {
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (bytes.size() < sizeof MAGIC + 8 + sizeof(uint64_t) || memcmp(bytes.data(), MAGIC, sizeof MAGIC) != 0)
+        throw runtime_error("Not a crawl checkpoint: " + path);
+    size_t body = bytes.size() - sizeof(uint64_t);
+    uint64_t hash;
+    memcpy(&hash, bytes.data() + body, sizeof hash);
+    if (hash != fnv1a(bytes.data(), body))
+        throw runtime_error("Damaged crawl checkpoint: " + path);
+
+    Reader r(bytes, body);
+    r.take(sizeof MAGIC);
+    if (r.u32() != VERSION)
+        throw runtime_error("Unsupported crawl checkpoint version: " + path);
+    r.u32();
+    if (r.str() != start)
+        throw runtime_error("Checkpoint " + path + " is for a crawl from another start node");
+    r.u32(); // depth it was started with; the resumed crawl may go further
+    state.current = r.u32();
+    state.levels.resize(r.u32());
+    for (auto& level : state.levels) {
+        level.resize(r.u32());
+        for (NodeId& id : level)
+            id = names.intern(r.str());
+    }
+    uint32_t flags = r.u32();
+    const char* p = r.take(flags);
+    state.expanded.assign(p, p + flags);
+    if (!r.done() || state.current >= state.levels.size() ||
+        state.expanded.size() != state.levels[state.current].size())
+        throw runtime_error("Damaged crawl checkpoint: " + path);
+    return true;
+}
+
+void CrawlCheckpoint::save(const string& start, int depth, const CrawlState& state, const StringInterner& names) {
+    string out;
+    out.append(MAGIC, sizeof MAGIC);
+    put_u32(out, VERSION);
+    put_u32(out, 0);
+    put_string(out, start);
+    put_u32(out, depth);
+    put_u32(out, state.current);
+    put_u32(out, state.levels.size());
+    for (const auto& level : state.levels) {
+        put_u32(out, level.size());
+        for (NodeId id : level)
+            put_string(out, names.name(id));
+    }
+    put_u32(out, state.expanded.size());
+    out.append(state.expanded.begin(), state.expanded.end());
+    uint64_t hash = fnv1a(out.data(), out.size());
+    out.append(reinterpret_cast<const char*>(&hash), sizeof hash);
+
+    string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw runtime_error("Cannot create checkpoint file: " + tmp);
+    bool ok = write_all(fd, out) && fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        throw runtime_error("Error writing checkpoint: " + path);
+    }
+    save_count++;
+}
+
+bool CheckpointOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt == "--resume") {
+        resume = true;
+        return true;
+    }
+    if (opt != "--checkpoint" && opt != "--checkpoint-interval")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--checkpoint")
+        path = argv[++i];
+    else
+        interval = stod(argv[++i]);
+    return true;
+}
+
+unique_ptr<CrawlCheckpoint> CheckpointOptions::open() const {
+    if (path.empty()) {
+        if (resume)
+            throw runtime_error("--resume needs --checkpoint <file>");
+        return nullptr;
+    }
+    return make_unique<CrawlCheckpoint>(path, interval);
+}
+
+CrawlState CheckpointOptions::resumed(const CrawlCheckpoint* checkpoint, const string& start,
+                                      StringInterner& names) const {
+    CrawlState state;
+    if (!checkpoint || !resume)
+        return state;
+    if (checkpoint->load(start, names, state))
+        cerr << "Resuming at level " << state.current << " from " << checkpoint->file() << "\n";
+    else
+        cerr << "No checkpoint at " << checkpoint->file() << ", starting a fresh crawl\n";
+    return state;
+}
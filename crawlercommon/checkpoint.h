@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "string_interner.h"
+
+// Where a level-synchronous crawl stands: levels[0..current] are complete,
+// levels[current + 1] (if present) holds what the expanded nodes of
+// levels[current] have found so far. The visited set is every node in levels.
+struct CrawlState {
+    std::vector<std::vector<NodeId>> levels;
+    size_t current = 0;
+    std::vector<uint8_t> expanded; // one flag per node of levels[current]
+};
+
+// Periodic on-disk snapshots of a crawl, so a failed or killed crawl can resume
+// instead of starting over.
+//
+// Layout (little endian): "CRAWLCKP" u32 version u32 reserved, u32 start_len,
+// start bytes, u32 depth, u32 current, u32 level_count, per level u32 count and
+// count x (u32 len, name bytes), then u32 expanded_count, expanded_count flag
+// bytes, and a u64 FNV-1a hash of everything before it.
+//
+// Snapshots are written to <path>.tmp, fsync'ed and renamed over path, so the
+// file always holds the last complete snapshot.
+class CrawlCheckpoint {
+public:
+    // interval_seconds between the periodic saves that due() asks for
+    CrawlCheckpoint(const std::string& path, double interval_seconds);
+
+    // Read the snapshot at path into state, interning its names. False if there
+    // is none; throws runtime_error if it is damaged or from a crawl of another
+    // start node.
+    bool load(const std::string& start, StringInterner& names, CrawlState& state) const;
+
+    // Thread-safe. True for exactly one caller once the interval has passed
+    // since the last save; that caller should save().
+    bool due();
+
+    // Write state atomically. Throws runtime_error if the file can't be written.
+    void save(const std::string& start, int depth, const CrawlState& state, const StringInterner& names);
+
+    size_t saves() const { return save_count; }
+    const std::string& file() const { return path; }
+
+private:
+    static int64_t now_ms();
+
+    std::string path;
+    int64_t interval_ms;
+    std::atomic<int64_t> next_due;
+    std::atomic<size_t> save_count{0};
+};
+
+// --checkpoint <file> --checkpoint-interval <seconds> --resume, shared by the level clients
+struct CheckpointOptions {
+    std::string path;
+    double interval = 30;
+    bool resume = false;
+
+    static const char* usage() { return "[--checkpoint <file>] [--checkpoint-interval <seconds>] [--resume]"; }
+
+    // Consume argv[i] (and its value) if it is a checkpoint option. Throws
+    // invalid_argument on a missing or malformed value.
+    bool parse(int argc, char* argv[], int& i);
+
+    // null (no snapshots) when no --checkpoint was given; throws
+    // runtime_error for --resume without --checkpoint
+    std::unique_ptr<CrawlCheckpoint> open() const;
+
+    // With --resume, the snapshot in checkpoint for start, said so on stderr;
+    // otherwise, or if there is none yet, an empty state (a fresh crawl).
+    // Throws runtime_error as CrawlCheckpoint::load does.
+    CrawlState resumed(const CrawlCheckpoint* checkpoint, const std::string& start, StringInterner& names) const;
+};
@@ -0,0 +1,160 @@
+#include "crawl_limits.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+CrawlLimits::CrawlLimits(double deadline_seconds, uint64_t max_requests)
+    : has_deadline(deadline_seconds > 0),
+      deadline(chrono::steady_clock::now() +
+               chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(deadline_seconds))),
+      max_requests(max_requests) {}
+
+void CrawlLimits::set_stop(Stop why) {
+    Stop none = Stop::None;
+    stop.compare_exchange_strong(none, why, memory_order_relaxed);
+}
+
+bool CrawlLimits::expired() {
+    if (!has_deadline || chrono::steady_clock::now() < deadline)
+        return false;
+    set_stop(Stop::Deadline);
+    return true;
+}
+
+uint64_t CrawlLimits::reserve(uint64_t n) {
+    if (n == 0 || expired())
+        return 0;
+    if (max_requests == 0) {
+        granted.fetch_add(n, memory_order_relaxed);
+        return n;
+    }
+    uint64_t used = granted.load(memory_order_relaxed);
+    uint64_t take;
+    do {
+        take = std::min(n, max_requests - std::min(used, max_requests));
+        if (take == 0) {
+            set_stop(Stop::Budget);
+            return 0;
+        }
+    } while (!granted.compare_exchange_weak(used, used + take, memory_order_relaxed));
+    if (take < n)
+        set_stop(Stop::Budget);
+    return take;
+}
+
+const char* CrawlLimits::reason() const {
+    switch (stopped()) {
+    case Stop::Deadline: return "the deadline";
+    case Stop::Budget: return "the request budget";
+    default: return "nothing";
+    }
+}
+
+void CrawlLimits::report(ostream& out, const vector<uint64_t>& found) const {
+    out << "Partial crawl, stopped by " << reason();
+    if (stopped() == Stop::Budget)
+        out << " (" << fetches() << " requests)";
+    out << "\n";
+    bool complete = true; // the last level holds everything at its depth
+    for (size_t d = 0; d <= expanded.size(); ++d) {
+        uint64_t count = d < found.size() ? found[d] : 0;
+        if (d < expanded.size()) {
+            out << "Level " << d << ": expanded " << expanded[d] << " of " << count << " nodes\n";
+            complete = expanded[d] == count;
+        } else {
+            out << "Level " << d << ": " << count << " nodes found, " << (complete ? "complete" : "partial") << "\n";
+        }
+    }
+}
+
+CrawlLimits::Watch::Watch(CrawlLimits* limits, atomic<bool>& flag) {
+    if (!limits || !limits->has_deadline)
+        return;
+    waiter = thread([this, limits, &flag] {
+        unique_lock<mutex> lock(m);
+        if (!done_cv.wait_until(lock, limits->deadline, [&] { return done; })) {
+            limits->expired();
+            flag = true;
+        }
+    });
+}
+
+CrawlLimits::Watch::~Watch() {
+    {
+        lock_guard<mutex> lock(m);
+        done = true;
+    }
+    done_cv.notify_one();
+    if (waiter.joinable())
+        waiter.join();
+}
+
+SeenDegreePriority::SeenDegreePriority() : segments(new atomic<atomic<uint32_t>*>[SEGMENTS]) {
+    for (size_t s = 0; s < SEGMENTS; ++s)
+        segments[s].store(nullptr, memory_order_relaxed);
+}
+
+SeenDegreePriority::~SeenDegreePriority() {
+    for (size_t s = 0; s < SEGMENTS; ++s)
+        delete[] segments[s].load(memory_order_relaxed);
+}
+
+atomic<uint32_t>& SeenDegreePriority::counter(NodeId id) {
+    const size_t words = size_t(1) << SEGMENT_BITS;
+    atomic<atomic<uint32_t>*>& slot = segments[id >> SEGMENT_BITS];
+    atomic<uint32_t>* seg = slot.load(memory_order_acquire);
+    if (!seg) {
+        atomic<uint32_t>* fresh = new atomic<uint32_t>[words];
+        for (size_t w = 0; w < words; ++w)
+            fresh[w].store(0, memory_order_relaxed);
+        if (slot.compare_exchange_strong(seg, fresh, memory_order_acq_rel))
+            seg = fresh;
+        else
+            delete[] fresh; // another thread installed it first; seg now holds theirs
+    }
+    return seg[id & (words - 1)];
+}
+
+uint32_t SeenDegreePriority::seen(NodeId id) const {
+    atomic<uint32_t>* seg = segments[id >> SEGMENT_BITS].load(memory_order_acquire);
+    return seg ? seg[id & ((size_t(1) << SEGMENT_BITS) - 1)].load(memory_order_relaxed) : 0;
+}
+
+void SeenDegreePriority::order(vector<NodeId>& frontier) {
+    vector<pair<uint32_t, NodeId>> keyed;
+    keyed.reserve(frontier.size());
+    for (NodeId id : frontier)
+        keyed.push_back({seen(id), id});
+    stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = 0; i < keyed.size(); ++i)
+        frontier[i] = keyed[i].second;
+}
+
+bool LimitOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt != "--deadline" && opt != "--max-requests" && opt != "--priority")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--deadline")
+        deadline = stod(argv[++i]);
+    else if (opt == "--max-requests")
+        max_requests = stoull(argv[++i]);
+    else if ((priority = argv[++i]) != "degree" && priority != "none")
+        throw invalid_argument("unknown --priority " + priority);
+    return true;
+}
+
+unique_ptr<CrawlLimits> LimitOptions::open() const {
+    if (deadline <= 0 && max_requests == 0)
+        return nullptr;
+    return make_unique<CrawlLimits>(deadline, max_requests);
+}
+
+unique_ptr<FrontierPriority> LimitOptions::open_priority() const {
+    if (priority == "none")
+        return nullptr;
+    return make_unique<SeenDegreePriority>();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "string_interner.h"
+
+// Wall-clock deadline and request budget for a crawl. The crawl asks before
+// every node it expands; once either limit is hit it stops handing out nodes,
+// lets the fetches in flight finish and returns what it has. The clock starts
+// when the limits are created.
+class CrawlLimits {
+public:
+    enum class Stop { None, Deadline, Budget };
+
+    // 0 disables either limit
+    CrawlLimits(double deadline_seconds, uint64_t max_requests);
+
+    bool limited() const { return has_deadline || max_requests > 0; }
+
+    // Reserve up to n node fetches from the service; returns how many were
+    // granted (all n without a budget). 0 also means the deadline has passed.
+    uint64_t reserve(uint64_t n);
+    // reserve(1) == 1
+    bool start_fetch() { return reserve(1) == 1; }
+
+    // true once the deadline has passed (cache hits only check this)
+    bool expired();
+
+    Stop stopped() const { return stop.load(std::memory_order_relaxed); }
+    const char* reason() const;
+    uint64_t fetches() const { return granted.load(std::memory_order_relaxed); }
+
+    // Nodes of each level the crawl expanded, set by the level engines as
+    // they return; short of the level's size only where the limits cut it.
+    void set_expanded(std::vector<size_t> counts) { expanded = std::move(counts); }
+
+    // After a stopped crawl, what stopped it and how far each level got;
+    // found[d] is the number of nodes found at depth d.
+    void report(std::ostream& out, const std::vector<uint64_t>& found) const;
+
+    // Sets *flag when the deadline passes, for engines that poll a stop flag,
+    // until the watch is destroyed.
+    class Watch {
+    public:
+        Watch(CrawlLimits* limits, std::atomic<bool>& flag);
+        ~Watch();
+
+    private:
+        std::mutex m;
+        std::condition_variable done_cv;
+        bool done = false;
+        std::thread waiter;
+    };
+
+private:
+    void set_stop(Stop why);
+
+    bool has_deadline;
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t max_requests;
+    std::atomic<uint64_t> granted{0};
+    std::atomic<Stop> stop{Stop::None};
+    std::vector<size_t> expanded;
+};
+
+// Orders a level's nodes before they are expanded, so that a deadline or
+// budget cuts the least promising ones. observe() is called for every neighbor
+// seen, from any crawl thread.
+class FrontierPriority {
+public:
+    virtual ~FrontierPriority() = default;
+    virtual void observe(NodeId neighbor) = 0;
+    // most promising first
+    virtual void order(std::vector<NodeId>& frontier) = 0;
+};
+
+// Expected fan-out from the degree seen so far: a node reached from many
+// expanded nodes (a movie with a large cast seen from several actors) likely
+// has many neighbors itself.
+class SeenDegreePriority : public FrontierPriority {
+public:
+    SeenDegreePriority();
+    ~SeenDegreePriority();
+
+    void observe(NodeId neighbor) override { counter(neighbor).fetch_add(1, std::memory_order_relaxed); }
+    void order(std::vector<NodeId>& frontier) override;
+
+private:
+    static const unsigned SEGMENT_BITS = 16;
+    static const size_t SEGMENTS = size_t(1) << (32 - SEGMENT_BITS);
+
+    std::atomic<uint32_t>& counter(NodeId id);
+    uint32_t seen(NodeId id) const;
+
+    std::unique_ptr<std::atomic<std::atomic<uint32_t>*>[]> segments;
+};
+
+// --deadline <seconds> --max-requests <n> --priority degree|none
+struct LimitOptions {
+    double deadline = 0;
+    uint64_t max_requests = 0;
+    std::string priority = "degree";
+
+    static const char* usage() { return "[--deadline <seconds>] [--max-requests <n>] [--priority degree|none]"; }
+
+    // Consume argv[i] (and its value) if it is a limit option. Throws
+    // invalid_argument on a missing or malformed value.
+    bool parse(int argc, char* argv[], int& i);
+
+    // null unless a deadline or budget was given
+    std::unique_ptr<CrawlLimits> open() const;
+    // null for "none" (discovery order)
+    std::unique_ptr<FrontierPriority> open_priority() const;
+};
@@ -0,0 +1,662 @@
+#include "neighbor_parser.h"
+
+#include "crawler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "atomic_bitmap.h"
+#include "atomic_depths.h"
+#include "level_pool.h"
+#include "multi_fetcher.h"
+#include "work_stealing.h"
+
+using namespace std;
+
+namespace {
+
+class HttpSession : public NeighborSource::Session {
+public:
+    HttpSession(const FetchContext& context, CrawlLimits* limits) : fetcher(context), limits(limits) {}
+
+    bool neighbors(const string& node, const NeighborSource::Emit& emit) override {
+        if (limits && !limits->start_fetch())
+            return false;
+        return fetcher.fetch(node, emit);
+    }
+
+private:
+    NeighborFetcher fetcher;
+    CrawlLimits* limits;
+};
+
+class CachedSession : public NeighborSource::Session {
+public:
+    CachedSession(NeighborCache& cache, unique_ptr<NeighborSource::Session> inner)
+        : cache(cache), inner(move(inner)) {}
+
+    bool neighbors(const string& node, const NeighborSource::Emit& emit) override {
+        if (cache.lookup_each(node, emit))
+            return true;
+        if (!inner || cache.offline())
+            return false;
+        vector<string> fetched;
+        bool ok = inner->neighbors(node, [&](string_view name) {
+            fetched.emplace_back(name);
+            emit(name);
+        });
+        if (ok)
+            cache.store(node, fetched);
+        return ok;
+    }
+
+private:
+    NeighborCache& cache;
+    unique_ptr<NeighborSource::Session> inner;
+};
+
+class CsrSession : public NeighborSource::Session {
+public:
+    explicit CsrSession(const CsrGraph& graph) : graph(graph) {}
+
+    bool neighbors(const string& node, const NeighborSource::Emit& emit) override {
+        CsrGraph::Node u;
+        if (!graph.find(node, u))
+            return false;
+        for (CsrGraph::Node v : graph.neighbors(u))
+            emit(graph.name(v));
+        return true;
+    }
+
+private:
+    const CsrGraph& graph;
+};
+
+// session.neighbors(), naming the node if it throws (a malformed response)
+bool expand(NeighborSource::Session& session, const string& node, const NeighborSource::Emit& emit) {
+    try {
+        return session.neighbors(node, emit);
+    } catch (const exception& e) {
+        cerr << "Error while fetching neighbors of: " << node << endl;
+        throw;
+    }
+}
+
+// Intern the start node and put it on level 0 (or out to the sink).
+NodeId seed(StringInterner& names, AtomicBitmap& visited, const string& start, OutputSink* sink,
+            vector<vector<NodeId>>& levels) {
+    NodeId id = names.intern(start);
+    visited.test_and_set(id);
+    if (sink)
+        sink->write(start, 0);
+    else
+        levels.push_back({id});
+    return id;
+}
+
+// Expand node at `level`: call claim(id) for each neighbor as it streams in,
+// and found(id) for those it claims (seen here first).
+template <class Claim, class Found>
+void visit_neighbors(NeighborSource::Session& session, StringInterner& names, NodeId node, int level,
+                     Telemetry* telemetry, Claim claim, Found found) {
+    size_t neighbors = 0, discovered = 0;
+    expand(session, names.name(node), [&](string_view neighbor) {
+        VisitTimer timer(telemetry);
+        ++neighbors;
+        NodeId id = names.intern(neighbor);
+        if (claim(id)) {
+            ++discovered;
+            found(id);
+        }
+    });
+    if (telemetry)
+        telemetry->record_expansion(level, neighbors, discovered);
+}
+
+// Responses with more neighbors than this are hubs: the rest of their list is
+// buffered and visited by every worker in HUB_GRAIN slices, so one huge movie
+// does not leave the others idle at the level barrier.
+const size_t HUB_INLINE = 2048;
+const size_t HUB_GRAIN = 1024;
+
+// Names buffered from a hub response, copied out since a cache hit's views do
+// not outlive the lookup.
+struct HubNames {
+    string bytes;
+    vector<size_t> ends;
+
+    void add(string_view name) {
+        bytes += name;
+        ends.push_back(bytes.size());
+    }
+    string_view operator[](size_t i) const {
+        size_t begin = i ? ends[i - 1] : 0;
+        return string_view(bytes).substr(begin, ends[i] - begin);
+    }
+    size_t size() const { return ends.size(); }
+    void clear() {
+        bytes.clear();
+        ends.clear();
+    }
+};
+
+// A failed snapshot is reported, not fatal: the crawl itself is still fine.
+void save_checkpoint(CrawlCheckpoint& checkpoint, const string& start, int depth, const CrawlState& state,
+                     const StringInterner& names) {
+    try {
+        checkpoint.save(start, depth, state, names);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+    }
+}
+
+// The level loop LevelSyncEngine and MultiEngine share: starting or resuming,
+// ordering a level under limits, committing each expanded node, snapshots, and
+// stopping part way through a level at the limits. The engines only expand
+// the current level, through visit() and commit().
+class LevelCrawl {
+public:
+    LevelCrawl(const EngineConfig& config, StringInterner& names, const string& start, int depth)
+        : config(config), names(names), start(start), depth(depth),
+          priority(config.limits ? config.priority : nullptr) {
+        if (config.resume)
+            state = *config.resume;
+    }
+
+    // NodeId -> name, for the sink
+    auto name_of() const {
+        return [this](NodeId id) -> const string& { return names.name(id); };
+    }
+
+    // Run the crawl, calling expand_level() once per level. It must commit()
+    // every node of nodes() that is not done(), until stopped().
+    template <class ExpandLevel>
+    vector<vector<NodeId>> run(ExpandLevel expand_level);
+
+    int level() const { return d; }
+    const vector<NodeId>& nodes() const { return state.levels[d]; }
+    // expanded before the crawl was resumed
+    bool done(size_t i) const { return state.expanded[i]; }
+
+    // true once the limits stop the crawl: start no more nodes
+    bool stopped() {
+        if (stop.load(memory_order_relaxed) || (config.limits && config.limits->expired())) {
+            stop = true;
+            return true;
+        }
+        return false;
+    }
+    void halt() { stop = true; }
+    // set when the deadline passes, for fetch loops that poll a flag
+    const atomic<bool>& stop_flag() const { return stop; }
+
+    // One neighbor of a node being expanded, through the interner and visited
+    // set; adjacent collects it for the CSR export.
+    void visit(string_view neighbor, vector<NodeId>& fresh, vector<NodeId>& adjacent) {
+        VisitTimer timer(config.telemetry);
+        NodeId id = names.intern(neighbor);
+        if (config.edges)
+            adjacent.push_back(id);
+        if (priority)
+            priority->observe(id);
+        if (visited.test_and_set(id))
+            fresh.push_back(id);
+    }
+
+    // Node i of the level is expanded: its discoveries and its done-flag are
+    // committed together, so a snapshot never has one without the other.
+    void commit(size_t i, const vector<NodeId>& fresh, const vector<NodeId>& adjacent, size_t neighbors) {
+        if (config.edges)
+            config.edges->add(state.levels[d][i], adjacent);
+        if (config.telemetry)
+            config.telemetry->record_expansion(d, neighbors, fresh.size());
+        if (config.sink)
+            config.sink->write_all(fresh.begin(), fresh.end(), d + 1, name_of());
+        {
+            auto guard = timed_lock(commit_mutex, config.telemetry);
+            vector<NodeId>& next = state.levels[d + 1];
+            next.insert(next.end(), fresh.begin(), fresh.end());
+            state.expanded[i] = 1;
+            expanded[d]++;
+        }
+        if (config.checkpoint && config.checkpoint->due())
+            snapshot();
+    }
+
+private:
+    // everything committed so far, as a resumable state
+    void snapshot() {
+        CrawlState partial;
+        {
+            lock_guard<mutex> lock(commit_mutex);
+            partial.levels = state.levels;
+            partial.expanded = state.expanded;
+        }
+        partial.current = d;
+        save_checkpoint(*config.checkpoint, start, depth, partial, names);
+    }
+
+    const EngineConfig& config;
+    StringInterner& names;
+    const string& start;
+    int depth;
+    FrontierPriority* priority; // only under limits
+    CrawlState state;
+    AtomicBitmap visited;
+    // nodes of each level that were expanded
+    vector<size_t> expanded;
+    int d = 0;
+    atomic<bool> stop{false};
+    mutex commit_mutex;
+};
+
+template <class ExpandLevel>
+vector<vector<NodeId>> LevelCrawl::run(ExpandLevel expand_level) {
+    vector<vector<NodeId>>& levels = state.levels;
+    OutputSink* sink = config.sink;
+    CrawlCheckpoint* checkpoint = config.checkpoint;
+    CrawlLimits* limits = config.limits;
+    // snapshots need every level, so only a streamed crawl without them frees
+    // each level once it is expanded
+    bool free_levels = sink && !checkpoint;
+
+    // A resumed crawl has everything in its levels visited, and streams them
+    // again since a new output file starts empty.
+    if (levels.empty()) {
+        levels.push_back({names.intern(start)});
+        state.current = 0;
+        state.expanded.assign(1, 0);
+    }
+    for (size_t k = 0; k < levels.size(); ++k) {
+        for (NodeId id : levels[k])
+            visited.test_and_set(id);
+        if (sink)
+            sink->write_all(levels[k].begin(), levels[k].end(), k, name_of());
+    }
+    for (size_t k = 0; k < state.current; ++k)
+        expanded.push_back(levels[k].size());
+
+    for (d = state.current; d < depth; d++) {
+        // ordering is skipped for a resumed level that is partly done, as its
+        // flags are positional
+        size_t done_before = std::count(state.expanded.begin(), state.expanded.end(), 1);
+        if (priority && done_before == 0)
+            priority->order(levels[d]);
+        if (levels.size() == size_t(d) + 1)
+            levels.push_back({});
+        expanded.resize(d + 1);
+        expanded[d] = done_before;
+        stop = false;
+        CrawlLimits::Watch watch(limits, stop);
+
+        try {
+            expand_level();
+        } catch (...) {
+            // keep what the level got done before giving up
+            if (checkpoint)
+                snapshot();
+            throw;
+        }
+
+        if (limits && expanded[d] < levels[d].size()) {
+            // the deadline passed or the budget ran out part way through the level;
+            // resumable with a later deadline or a bigger budget
+            limits->expired();
+            if (checkpoint)
+                save_checkpoint(*checkpoint, start, depth, state, names);
+            break;
+        }
+        state.current = d + 1;
+        state.expanded.assign(levels[d + 1].size(), 0);
+        if (checkpoint)
+            save_checkpoint(*checkpoint, start, depth, state, names);
+        if (free_levels)
+            vector<NodeId>().swap(levels[d]);
+    }
+
+    // a crawl stopped by its limits keeps the partly found level after the
+    // one it was expanding
+    size_t keep = std::max(depth, 0) + 1;
+    if (limits && limits->stopped() != CrawlLimits::Stop::None)
+        keep = std::min(keep, state.current + 2);
+    if (levels.size() > keep)
+        levels.resize(keep); // resumed from a deeper crawl
+    expanded.resize(levels.size() - 1);
+    if (limits)
+        limits->set_expanded(expanded);
+    if (sink)
+        levels.clear();
+    return std::move(levels);
+}
+
+} // namespace
+
+unique_ptr<NeighborSource::Session> HttpSource::session() {
+    return make_unique<HttpSession>(context, limits);
+}
+
+unique_ptr<NeighborSource::Session> CachedSource::session() {
+    return make_unique<CachedSession>(neighbor_cache, inner ? inner->session() : nullptr);
+}
+
+unique_ptr<NeighborSource::Session> CsrSource::session() {
+    return make_unique<CsrSession>(graph);
+}
+
+vector<vector<NodeId>> SequentialEngine::crawl(NeighborSource& source, StringInterner& names, const string& start,
+                                               int depth) {
+    vector<vector<NodeId>> levels;
+    AtomicBitmap visited;
+    unique_ptr<NeighborSource::Session> session = source.session();
+    auto name_of = [&](NodeId id) -> const string& { return names.name(id); };
+    auto mark = [&](NodeId id) { return visited.test_and_set(id); };
+
+    NodeId start_id = seed(names, visited, start, config.sink, levels);
+    if (depth <= 0)
+        return levels;
+    deque<pair<NodeId, int>> queue = {{start_id, 0}};
+    vector<NodeId> fresh;
+    while (!queue.empty()) {
+        auto [node, level] = queue.front();
+        queue.pop_front();
+
+        fresh.clear();
+        visit_neighbors(*session, names, node, level, config.telemetry, mark, [&](NodeId id) {
+            // nodes on the last level are recorded but never expanded
+            if (level + 1 < depth)
+                queue.push_back({id, level + 1});
+            fresh.push_back(id);
+        });
+        if (config.sink) {
+            config.sink->write_all(fresh.begin(), fresh.end(), level + 1, name_of);
+        } else if (!fresh.empty()) {
+            if (levels.size() <= size_t(level + 1))
+                levels.push_back({});
+            levels[level + 1].insert(levels[level + 1].end(), fresh.begin(), fresh.end());
+        }
+    }
+    return levels;
+}
+
+vector<vector<NodeId>> LevelSyncEngine::crawl(NeighborSource& source, StringInterner& names, const string& start,
+                                              int depth) {
+    LevelCrawl crawl(config, names, start, depth);
+    CrawlLimits* limits = config.limits;
+    // started once for the whole crawl and parked between levels
+    LevelPool pool(config.threads);
+    // one session and scratch lists per worker, reused for every level
+    struct Worker {
+        unique_ptr<NeighborSource::Session> session;
+        vector<NodeId> fresh, adjacent;
+        HubNames hub;
+    };
+    vector<Worker> workers(pool.size());
+    for (Worker& w : workers)
+        w.session = source.session();
+
+    // expand node i of the level on worker tid; false once the limits stop the crawl
+    auto expand_node = [&](int tid, size_t i) {
+        if (crawl.done(i))
+            return true;
+        if (crawl.stopped())
+            return false;
+        Worker& w = workers[tid];
+        size_t neighbors = 0;
+        w.fresh.clear();
+        w.adjacent.clear();
+        w.hub.clear();
+        bool ok = expand(*w.session, names.name(crawl.nodes()[i]), [&](string_view neighbor) {
+            if (++neighbors > HUB_INLINE)
+                w.hub.add(neighbor);
+            else
+                crawl.visit(neighbor, w.fresh, w.adjacent);
+        });
+        if (!ok && limits && limits->stopped() != CrawlLimits::Stop::None) {
+            // refused by the budget: left for a resume
+            crawl.halt();
+            return false;
+        }
+        if (w.hub.size()) {
+            // the rest of a hub's list goes to every worker, one slice each
+            size_t slices = (w.hub.size() + HUB_GRAIN - 1) / HUB_GRAIN;
+            vector<vector<NodeId>> hub_fresh(slices), hub_adjacent(slices);
+            pool.split(tid, w.hub.size(), HUB_GRAIN, [&](int, size_t begin, size_t end) {
+                size_t k = begin / HUB_GRAIN;
+                for (size_t j = begin; j < end; ++j)
+                    crawl.visit(w.hub[j], hub_fresh[k], hub_adjacent[k]);
+            });
+            for (size_t k = 0; k < slices; ++k) {
+                w.fresh.insert(w.fresh.end(), hub_fresh[k].begin(), hub_fresh[k].end());
+                w.adjacent.insert(w.adjacent.end(), hub_adjacent[k].begin(), hub_adjacent[k].end());
+            }
+        }
+        crawl.commit(i, w.fresh, w.adjacent, neighbors);
+        return true;
+    };
+
+    // nodes go out one at a time from the pool's cursor (in priority order
+    // with limits, so a cut falls on the least promising ones)
+    return crawl.run([&] { pool.run(crawl.nodes().size(), expand_node); });
+}
+
+vector<vector<NodeId>> MultiEngine::crawl(NeighborSource& source, StringInterner& names, const string& start,
+                                          int depth) {
+    const FetchContext* context = source.service();
+    NeighborCache* cache = source.cache();
+    if (!context)
+        throw invalid_argument("the multi engine needs the neighbors service as its source");
+    LevelCrawl crawl(config, names, start, depth);
+    CrawlLimits* limits = config.limits;
+    Telemetry* telemetry = config.telemetry;
+    MultiFetcher fetcher(config.max_in_flight, std::min(2, config.loops), *context);
+    // one parser per event loop, reused across responses
+    vector<unique_ptr<NeighborParser>> parsers;
+    for (int l = 0; l < fetcher.loop_count(); ++l)
+        parsers.push_back(make_unique<NeighborParser>());
+
+    return crawl.run([&] {
+        const vector<NodeId>& nodes = crawl.nodes();
+        // expand cached nodes right away and only put the misses on the wire
+        vector<size_t> to_fetch; // positions in nodes
+        for (size_t pos = 0; pos < nodes.size(); ++pos) {
+            if (crawl.done(pos))
+                continue;
+            if (limits && limits->expired())
+                break;
+            vector<NodeId> fresh, adjacent;
+            size_t neighbors = 0;
+            auto visit = [&](string_view n) {
+                ++neighbors;
+                crawl.visit(n, fresh, adjacent);
+            };
+            if (cache && cache->lookup_each(names.name(nodes[pos]), visit))
+                crawl.commit(pos, fresh, adjacent, neighbors);
+            else if (!cache || !cache->offline())
+                to_fetch.push_back(pos);
+            else
+                crawl.commit(pos, fresh, adjacent, 0); // offline miss: no neighbors
+        }
+        // the budget is spent up front, in priority order
+        if (limits)
+            to_fetch.resize(limits->reserve(to_fetch.size()));
+
+        auto name_of = [&](size_t i) -> const string& { return names.name(nodes[to_fetch[i]]); };
+        fetcher.fetch_all(to_fetch.size(), name_of, [&](size_t i, string& response, bool ok, int loop) {
+            const string& s = name_of(i);
+            try {
+                vector<NodeId> fresh, adjacent;
+                size_t neighbors = 0;
+                vector<string> fetched; // only kept for the cache write-through
+                bool store = ok && cache;
+                bool is_object;
+                {
+                    ParseTimer timer(telemetry);
+                    is_object = parsers[loop]->parse(response, [&](string_view n) {
+                        if (store)
+                            fetched.emplace_back(n);
+                        ++neighbors;
+                        crawl.visit(n, fresh, adjacent);
+                    });
+                }
+                if (!is_object)
+                    cerr << "Invalid JSON object for: " << s << endl;
+                if (store)
+                    cache->store(s, fetched);
+                crawl.commit(to_fetch[i], fresh, adjacent, neighbors);
+            } catch (const ParseException& e) {
+                cerr << "Error while fetching neighbors of: " << s << endl;
+                throw;
+            }
+        }, &crawl.stop_flag());
+    });
+}
+
+vector<vector<NodeId>> QueueEngine::crawl(NeighborSource& source, StringInterner& names, const string& start,
+                                          int depth) {
+    AtomicDepths depths;
+    Telemetry* telemetry = config.telemetry;
+    OutputSink* sink = config.sink;
+
+    // (node, level) tasks, one deque per worker; finishes once no task is outstanding
+    WorkStealingPool<pair<NodeId, int>> pool(config.threads);
+    vector<unique_ptr<NeighborSource::Session>> sessions;
+    for (int t = 0; t < pool.size(); ++t)
+        sessions.push_back(source.session());
+    auto name_of = [&](NodeId id) -> const string& { return names.name(id); };
+
+    // Tasks run oldest first, but with no barrier a slow response can still
+    // let a node be reached along a longer path first. Its depth is lowered
+    // when the shorter path turns up, and it is expanded again from there.
+    // levels[d] collects every node ever given depth d; level d is settled
+    // (filtered to the nodes still at d, and streamed to the sink) once no
+    // task below d is left, as only those can give a node depth d or less.
+    NodeId start_id = names.intern(start);
+    depths.lower(start_id, 0);
+    vector<vector<NodeId>> levels = {{start_id}};
+    vector<size_t> pending = {1}; // tasks queued or running, per level
+    size_t settled = 0;
+    mutex level_mutex;
+    auto settle = [&] {
+        while (settled < levels.size() && (settled == 0 || pending[settled - 1] == 0)) {
+            vector<NodeId>& level = levels[settled];
+            level.erase(remove_if(level.begin(), level.end(),
+                                  [&](NodeId id) { return depths.get(id) != int(settled); }),
+                        level.end());
+            if (sink) {
+                sink->write_all(level.begin(), level.end(), settled, name_of);
+                vector<NodeId>().swap(level);
+            }
+            ++settled;
+        }
+    };
+
+    settle();
+    if (depth <= 0)
+        return sink ? vector<vector<NodeId>>() : levels;
+    if (telemetry)
+        telemetry->set_queue_depth([&pool] { return pool.queued_tasks(); });
+
+    pool.run({{start_id, 0}}, [&](int worker, const pair<NodeId, int>& task) {
+        auto [node, level] = task;
+
+        // dedup without a global lock, then take level_mutex once per response;
+        // skip a task whose node has since been queued at a lower level
+        vector<NodeId> fresh;
+        if (depths.get(node) == level)
+            visit_neighbors(
+                *sessions[worker], names, node, level, telemetry,
+                [&](NodeId id) { return depths.lower(id, level + 1); }, [&](NodeId id) { fresh.push_back(id); });
+        // nodes on the last level are recorded but never expanded
+        bool queue_children = level + 1 < depth;
+        {
+            auto guard = timed_lock(level_mutex, telemetry);
+            if (!fresh.empty()) {
+                if (levels.size() <= size_t(level + 1)) {
+                    levels.resize(level + 2);
+                    pending.resize(level + 2);
+                }
+                levels[level + 1].insert(levels[level + 1].end(), fresh.begin(), fresh.end());
+                if (queue_children)
+                    pending[level + 1] += fresh.size();
+            }
+            pending[level]--;
+            settle();
+        }
+        if (queue_children)
+            for (NodeId id : fresh)
+                pool.push(worker, {id, level + 1});
+    });
+    if (telemetry)
+        telemetry->set_queue_depth(nullptr);
+
+    if (sink)
+        return {};
+    while (!levels.empty() && levels.back().empty())
+        levels.pop_back();
+    return levels;
+}
+
+unique_ptr<TraversalEngine> make_engine(const string& name, const EngineConfig& config) {
+    if (name == "level")
+        return make_unique<LevelSyncEngine>(config);
+    if (name == "multi")
+        return make_unique<MultiEngine>(config);
+    if (name != "sequential" && name != "queue")
+        throw invalid_argument("unknown engine " + name);
+    if (config.checkpoint || config.resume || config.edges || config.limits)
+        throw invalid_argument("checkpoints, --export-csr and crawl limits need the level or multi engine");
+    if (name == "sequential")
+        return make_unique<SequentialEngine>(config);
+    return make_unique<QueueEngine>(config);
+}
+
+const char* engine_names() {
+    return "sequential|level|multi|queue";
+}
+
+double report_crawl(const vector<vector<NodeId>>& levels, const StringInterner& names, OutputSink* sink,
+                    const CrawlLimits* limits, chrono::steady_clock::time_point start) {
+    for (const auto& level : levels) {
+        for (NodeId id : level)
+            cout << "- " << names.name(id) << "\n";
+        cout << level.size() << "\n";
+    }
+    // with --output - stdout belongs to the stream
+    ostream& out = sink ? cerr : cout;
+    vector<uint64_t> counts;
+    if (sink) {
+        // the nodes are already out; report level sizes beside the stream
+        try {
+            sink->close();
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+        }
+        counts = sink->depth_counts();
+        for (size_t d = 0; d < counts.size(); ++d)
+            cerr << "Level " << d << ": " << counts[d] << " nodes\n";
+    } else {
+        for (const auto& level : levels)
+            counts.push_back(level.size());
+    }
+    if (limits && limits->stopped() != CrawlLimits::Stop::None)
+        limits->report(out, counts);
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    out << "Time to crawl: " << elapsed.count() << "s\n";
+    return elapsed.count();
+}
+
+void export_edges(const EdgeList& edges, const string& path, const StringInterner& names) {
+    try {
+        edges.write_csr(path, names.size(), [&](NodeId id) -> const string& { return names.name(id); });
+        cerr << "Exported " << names.size() << " nodes to " << path << "\n";
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "checkpoint.h"
+#include "crawl_limits.h"
+#include "csr_graph.h"
+#include "http_client.h"
+#include "neighbor_cache.h"
+#include "output_sink.h"
+#include "string_interner.h"
+#include "telemetry.h"
+
+// The crawler library (libcrawler.a): where neighbors come from, and the
+// traversal engines that walk them. Programs pick a source and an engine;
+// every engine runs unchanged over every source.
+
+// Where neighbor lists come from. Engines open one Session per worker thread,
+// so a session may keep per-thread state (a keep-alive handle, a parser).
+class NeighborSource {
+public:
+    using Emit = std::function<void(std::string_view)>;
+
+    class Session {
+    public:
+        virtual ~Session() = default;
+        // Stream the neighbors of node to emit. False if they could not be
+        // fetched (nothing was emitted).
+        virtual bool neighbors(const std::string& node, const Emit& emit) = 0;
+    };
+
+    virtual ~NeighborSource() = default;
+    virtual std::unique_ptr<Session> session() = 0;
+
+    // For engines that drive their own transfers (curl_multi) instead of
+    // sessions: the service behind this source and the cache in front of it,
+    // null where there is none.
+    virtual const FetchContext* service() const { return nullptr; }
+    virtual NeighborCache* cache() const { return nullptr; }
+};
+
+// The neighbors service, through a keep-alive HttpClient and SAX parser per
+// session. With limits, every fetch first takes a request from its budget; a
+// refused one returns false.
+class HttpSource : public NeighborSource {
+public:
+    explicit HttpSource(const FetchContext& context, CrawlLimits* limits = nullptr)
+        : context(context), limits(limits) {}
+    std::unique_ptr<Session> session() override;
+    const FetchContext* service() const override { return &context; }
+
+private:
+    FetchContext context;
+    CrawlLimits* limits;
+};
+
+// NeighborCache in front of another source, with write-through; inner may be
+// null for an offline cache, where misses have no neighbors.
+class CachedSource : public NeighborSource {
+public:
+    CachedSource(NeighborCache& cache, NeighborSource* inner) : neighbor_cache(cache), inner(inner) {}
+    std::unique_ptr<Session> session() override;
+    const FetchContext* service() const override { return inner ? inner->service() : nullptr; }
+    NeighborCache* cache() const override { return &neighbor_cache; }
+
+private:
+    NeighborCache& neighbor_cache;
+    NeighborSource* inner;
+};
+
+// A local graph file exported with --export-csr; unknown nodes have no neighbors.
+class CsrSource : public NeighborSource {
+public:
+    explicit CsrSource(const CsrGraph& graph) : graph(graph) {}
+    std::unique_ptr<Session> session() override;
+
+private:
+    const CsrGraph& graph;
+};
+
+struct EngineConfig {
+    int threads = 1;
+    Telemetry* telemetry = nullptr;
+    // nodes are streamed here as they are found; crawl() then returns no levels
+    OutputSink* sink = nullptr;
+
+    // The rest is for the level-synchronous engines, level and multi;
+    // make_engine rejects it for the others.
+    // state saved after every level and every interval within one
+    CrawlCheckpoint* checkpoint = nullptr;
+    // a snapshot to continue from (see CheckpointOptions::resumed)
+    const CrawlState* resume = nullptr;
+    // every expanded node's neighbor list, for --export-csr
+    EdgeList* edges = nullptr;
+    // deadline / request budget: the crawl stops handing out nodes once hit,
+    // expanding each level in priority's order (null: discovery order)
+    CrawlLimits* limits = nullptr;
+    FrontierPriority* priority = nullptr;
+    // multi engine: transfers in flight, and event-loop threads (1 or 2)
+    int max_in_flight = 64;
+    int loops = 1;
+};
+
+// A traversal strategy. crawl() returns levels[d] = the nodes first reached at
+// depth d, for d = 0..depth; the order within a level depends on the engine.
+class TraversalEngine {
+public:
+    virtual ~TraversalEngine() = default;
+    virtual std::vector<std::vector<NodeId>> crawl(NeighborSource& source, StringInterner& names,
+                                                   const std::string& start, int depth) = 0;
+};
+
+// FIFO BFS on the calling thread: levels come out in discovery order.
+class SequentialEngine : public TraversalEngine {
+public:
+    explicit SequentialEngine(const EngineConfig& config) : config(config) {}
+    std::vector<std::vector<NodeId>> crawl(NeighborSource& source, StringInterner& names, const std::string& start,
+                                           int depth) override;
+
+private:
+    EngineConfig config;
+};
+
+// One level at a time, with a barrier between levels: a LevelPool of
+// config.threads workers, started once per crawl, takes the level's nodes from
+// a shared cursor, and a hub's long neighbor list is split across the idle
+// ones. Returns depth + 1 levels (trailing ones may be empty), and supports
+// checkpoints and resume, CSR export and crawl limits.
+class LevelSyncEngine : public TraversalEngine {
+public:
+    explicit LevelSyncEngine(const EngineConfig& config) : config(config) {}
+    std::vector<std::vector<NodeId>> crawl(NeighborSource& source, StringInterner& names, const std::string& start,
+                                           int depth) override;
+
+private:
+    EngineConfig config;
+};
+
+// LevelSyncEngine's levels with the fetches of a level on curl_multi event
+// loops (config.max_in_flight transfers over config.loops threads) instead of
+// a blocking thread per request. Cached nodes are expanded first, so only the
+// misses go on the wire. Needs a source with a service().
+class MultiEngine : public TraversalEngine {
+public:
+    explicit MultiEngine(const EngineConfig& config) : config(config) {}
+    std::vector<std::vector<NodeId>> crawl(NeighborSource& source, StringInterner& names, const std::string& start,
+                                           int depth) override;
+
+private:
+    EngineConfig config;
+};
+
+// No level barrier: (node, depth) tasks on a WorkStealingPool of config.threads
+// workers, each response's new nodes queued as soon as it is parsed. A node
+// later reached by a shorter path moves up to that level and is expanded again.
+class QueueEngine : public TraversalEngine {
+public:
+    explicit QueueEngine(const EngineConfig& config) : config(config) {}
+    std::vector<std::vector<NodeId>> crawl(NeighborSource& source, StringInterner& names, const std::string& start,
+                                           int depth) override;
+
+private:
+    EngineConfig config;
+};
+
+// "sequential", "level", "multi" or "queue"; throws invalid_argument for
+// anything else, or for level-only config on sequential or queue
+std::unique_ptr<TraversalEngine> make_engine(const std::string& name, const EngineConfig& config);
+const char* engine_names();
+
+// The end of a crawl in level_client's format: each level's nodes as "- <name>"
+// and then its size, or for a crawl streamed to sink its level sizes (the sink
+// is closed first); the partial-crawl report if limits stopped it; and "Time
+// to crawl" since start. Returns those seconds.
+double report_crawl(const std::vector<std::vector<NodeId>>& levels, const StringInterner& names, OutputSink* sink,
+                    const CrawlLimits* limits, std::chrono::steady_clock::time_point start);
+
+// Write the edges a crawl recorded to a CSR file at path (--export-csr),
+// reporting on stderr. Call it after report_crawl: the export is not part of
+// the crawl's time.
+void export_edges(const EdgeList& edges, const std::string& path, const StringInterner& names);
@@ -0,0 +1,176 @@
+#include "csr_graph.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = {'C', 'S', 'R', 'G', 'R', 'A', 'P', 'H'};
+const uint32_t VERSION = 1;
+const uint64_t HEADER_SIZE = 32;
+
+uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+template <class T>
+void put(ofstream& out, const T* p, size_t count) {
+    out.write(reinterpret_cast<const char*>(p), count * sizeof(T));
+}
+
+void pad8(ofstream& out, uint64_t written) {
+    static const char ZEROS[8] = {};
+    out.write(ZEROS, align8(written) - written);
+}
+
+} // namespace
+
+CsrGraph::CsrGraph(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Cannot open graph file: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || uint64_t(st.st_size) < HEADER_SIZE) {
+        close(fd);
+        throw runtime_error("Not a CSR graph file: " + path);
+    }
+    length = st.st_size;
+    void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw runtime_error("Cannot mmap graph file: " + path);
+    data = static_cast<const char*>(p);
+
+    uint32_t version;
+    memcpy(&version, data + 8, 4);
+    memcpy(&flags, data + 12, 4);
+    memcpy(&nodes, data + 16, 8);
+    memcpy(&edges, data + 24, 8);
+    auto invalid = [&] {
+        munmap((void*)data, length);
+        data = nullptr;
+        return runtime_error("Not a CSR graph file: " + path);
+    };
+    if (memcmp(data, MAGIC, sizeof MAGIC) != 0 || version != VERSION || nodes >= UINT32_MAX ||
+        edges > length)
+        throw invalid();
+
+    uint64_t pos = HEADER_SIZE;
+    offsets = reinterpret_cast<const uint64_t*>(data + pos);
+    pos += (nodes + 1) * 8;
+    targets = reinterpret_cast<const Node*>(data + pos);
+    pos = align8(pos + edges * 4);
+    name_offsets = reinterpret_cast<const uint64_t*>(data + pos);
+    pos += (nodes + 1) * 8;
+    by_name = reinterpret_cast<const Node*>(data + pos);
+    pos = align8(pos + nodes * 4);
+    names = data + pos;
+    if (pos > length || offsets[0] != 0 || offsets[nodes] != edges || name_offsets[0] != 0 ||
+        name_offsets[nodes] != length - pos)
+        throw invalid();
+    // checked once here so lookups can trust the arrays
+    for (uint64_t u = 0; u < nodes; ++u)
+        if (offsets[u] > offsets[u + 1] || name_offsets[u] > name_offsets[u + 1] || by_name[u] >= nodes)
+            throw invalid();
+    for (uint64_t e = 0; e < edges; ++e)
+        if (targets[e] >= nodes)
+            throw invalid();
+}
+
+CsrGraph::~CsrGraph() {
+    if (data)
+        munmap((void*)data, length);
+}
+
+bool CsrGraph::find(string_view key, Node& u) const {
+    const Node* it = lower_bound(by_name, by_name + nodes, key,
+                                 [&](Node v, string_view k) { return name(v) < k; });
+    if (it == by_name + nodes || name(*it) != key)
+        return false;
+    u = *it;
+    return true;
+}
+
+void EdgeList::add(uint32_t from, const vector<uint32_t>& to) {
+    lock_guard<mutex> lock(m);
+    for (uint32_t v : to)
+        edges.push_back({from, v});
+}
+
+size_t EdgeList::size() const {
+    lock_guard<mutex> lock(m);
+    return edges.size();
+}
+
+void EdgeList::write_csr(const string& path, size_t node_count,
+                         const function<const string&(uint32_t)>& name_of) const {
+    lock_guard<mutex> lock(m);
+
+    // both directions of every edge, bucketed by source
+    vector<uint64_t> offsets(node_count + 1, 0);
+    for (auto [u, v] : edges)
+        if (u != v) {
+            offsets[u + 1]++;
+            offsets[v + 1]++;
+        }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    vector<uint32_t> targets(offsets[node_count]);
+    vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    for (auto [u, v] : edges)
+        if (u != v) {
+            targets[fill[u]++] = v;
+            targets[fill[v]++] = u;
+        }
+
+    // sort and dedup each row, compacting in place
+    uint64_t kept = 0;
+    for (size_t u = 0; u < node_count; ++u) {
+        auto first = targets.begin() + offsets[u], last = targets.begin() + offsets[u + 1];
+        sort(first, last);
+        last = unique(first, last);
+        offsets[u] = kept;
+        kept = copy(first, last, targets.begin() + kept) - targets.begin();
+    }
+    offsets[node_count] = kept;
+    targets.resize(kept);
+
+    vector<uint64_t> name_offsets(node_count + 1, 0);
+    for (size_t u = 0; u < node_count; ++u)
+        name_offsets[u + 1] = name_offsets[u] + name_of(u).size();
+    vector<uint32_t> by_name(node_count);
+    iota(by_name.begin(), by_name.end(), 0);
+    sort(by_name.begin(), by_name.end(), [&](uint32_t a, uint32_t b) { return name_of(a) < name_of(b); });
+
+    string tmp = path + ".tmp";
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!out)
+        throw runtime_error("Cannot create graph file: " + tmp);
+    uint64_t header[2] = {node_count, kept};
+    uint32_t words[2] = {VERSION, CsrGraph::UNDIRECTED};
+    out.write(MAGIC, sizeof MAGIC);
+    put(out, words, 2);
+    put(out, header, 2);
+    put(out, offsets.data(), offsets.size());
+    put(out, targets.data(), targets.size());
+    pad8(out, targets.size() * 4);
+    put(out, name_offsets.data(), name_offsets.size());
+    put(out, by_name.data(), by_name.size());
+    pad8(out, by_name.size() * 4);
+    for (size_t u = 0; u < node_count; ++u)
+        out << name_of(u);
+    out.close();
+    if (!out || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        throw runtime_error("Error writing graph file: " + path);
+    }
+}
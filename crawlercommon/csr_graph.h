@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Crawled subgraph in compressed sparse row form, stored as one file that is
+// used straight from a read-only mapping.
+//
+// Layout (little endian, every array 8-byte aligned):
+//   "CSRGRAPH" u32 version u32 flags (bit 0: undirected), u64 nodes, u64 edges
+//   u64 offsets[nodes + 1]     neighbors of u are targets[offsets[u]..offsets[u+1])
+//   u32 targets[edges]         sorted, no duplicates
+//   u64 name_offsets[nodes + 1] name of u is names[name_offsets[u]..name_offsets[u+1])
+//   u32 by_name[nodes]         node ids sorted by name, for lookups
+//   names
+// Ids are the crawl's NodeIds, i.e. roughly BFS discovery order.
+class CsrGraph {
+public:
+    using Node = uint32_t;
+
+    struct Range {
+        const Node* first;
+        const Node* last;
+        const Node* begin() const { return first; }
+        const Node* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    // Throws runtime_error if the file is missing or not a valid graph.
+    explicit CsrGraph(const std::string& path);
+    ~CsrGraph();
+
+    CsrGraph(const CsrGraph&) = delete;
+    CsrGraph& operator=(const CsrGraph&) = delete;
+
+    size_t node_count() const { return nodes; }
+    size_t edge_count() const { return edges; }
+    bool undirected() const { return flags & UNDIRECTED; }
+
+    Range neighbors(Node u) const { return {targets + offsets[u], targets + offsets[u + 1]}; }
+    size_t degree(Node u) const { return offsets[u + 1] - offsets[u]; }
+    std::string_view name(Node u) const {
+        return std::string_view(names + name_offsets[u], name_offsets[u + 1] - name_offsets[u]);
+    }
+
+    // id of the node called name; false if it is not in the graph
+    bool find(std::string_view name, Node& u) const;
+
+    static const uint32_t UNDIRECTED = 1;
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    uint32_t flags = 0;
+    uint64_t nodes = 0;
+    uint64_t edges = 0;
+    const uint64_t* offsets = nullptr;
+    const Node* targets = nullptr;
+    const uint64_t* name_offsets = nullptr;
+    const Node* by_name = nullptr;
+    const char* names = nullptr;
+};
+
+// Edges seen while crawling, for --export-csr. Thread-safe; takes its lock once
+// per expanded node.
+class EdgeList {
+public:
+    void add(uint32_t from, const std::vector<uint32_t>& to);
+
+    // Write nodes 0..node_count-1 and the recorded edges, made undirected, as a
+    // CsrGraph file. Throws runtime_error if it can't be written.
+    void write_csr(const std::string& path, size_t node_count,
+                   const std::function<const std::string&(uint32_t)>& name_of) const;
+
+    size_t size() const;
+
+private:
+    mutable std::mutex m;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+};
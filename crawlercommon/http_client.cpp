@@ -0,0 +1,180 @@
+#include "http_client.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* output) {
+    size_t totalSize = size * nmemb;
+    output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+string url_encode(CURL* curl, const string& input) {
+    char* out = curl_easy_escape(curl, input.c_str(), input.size());
+    string s = out;
+    curl_free(out);
+    return s;
+}
+
+CurlShare::CurlShare() {
+    share = curl_share_init();
+    if (!share)
+        throw runtime_error("CURL error: Failed to create share handle");
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlShare::~CurlShare() {
+    curl_share_cleanup(share);
+}
+
+void CurlShare::lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<CurlShare*>(userptr)->locks[data].lock();
+}
+
+void CurlShare::unlock(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<CurlShare*>(userptr)->locks[data].unlock();
+}
+
+FetchScope::FetchScope(const FetchOptions& options, Telemetry* telemetry)
+    : controller(options.rate), fetch_context{options.service_url, &share, &controller, telemetry} {}
+
+struct curl_slist* default_headers() {
+    return curl_slist_append(nullptr, "User-Agent: C++-Client/1.0");
+}
+
+void configure_handle(CURL* curl, CurlShare* share, struct curl_slist* headers, string* response) {
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
+    if (share)
+        curl_easy_setopt(curl, CURLOPT_SHARE, share->get());
+}
+
+bool FetchOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt != "--service" && opt != "--max-rate" && opt != "--retries")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--service")
+        service_url = argv[++i];
+    else if (opt == "--max-rate")
+        rate.max_rate = stod(argv[++i]);
+    else
+        rate.max_retries = stoi(argv[++i]);
+    return true;
+}
+
+HttpClient::HttpClient(const FetchContext& context) : context(context) {
+    curl = curl_easy_init();
+    if (!curl)
+        throw runtime_error("CURL error: Failed initialization");
+    headers = default_headers();
+    configure_handle(curl, context.share, headers, &response);
+}
+
+HttpClient::~HttpClient() {
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+}
+
+string& HttpClient::fetch_neighbors(const string& node) {
+    string url = context.service_url + url_encode(curl, node);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    RateController* rate = context.rate;
+    Telemetry* telemetry = context.telemetry;
+
+    for (int attempt = 0;; ++attempt) {
+        response.clear();
+        if (rate)
+            rate->acquire();
+        if (telemetry)
+            telemetry->request_started();
+        auto sent = chrono::steady_clock::now();
+        CURLcode res = curl_easy_perform(curl);
+        TransferResult result = classify_transfer(curl, res);
+        auto latency = chrono::steady_clock::now() - sent;
+        if (telemetry)
+            telemetry->request_finished(chrono::duration_cast<chrono::nanoseconds>(latency).count(),
+                                        response.size(), result.outcome == FetchOutcome::Ok);
+        if (rate)
+            rate->release(result.outcome, chrono::duration<double>(latency).count(), result.retry_after);
+        succeeded = result.outcome == FetchOutcome::Ok;
+
+        if (rate && retryable(result.outcome) && attempt < rate->options().max_retries) {
+            this_thread::sleep_for(chrono::duration<double>(rate->retry_delay(attempt, result.retry_after)));
+            continue;
+        }
+
+        if (res != CURLE_OK)
+            cerr << "CURL error: " << curl_easy_strerror(res) << endl;
+        if (retryable(result.outcome)) {
+            cerr << "Giving up on " << node << " after " << attempt + 1 << " attempts" << endl;
+            if (rate)
+                rate->record_failure(node);
+        }
+        // whatever a non-2xx body holds, it is not a neighbor list
+        if (!succeeded)
+            response = "{}";
+        return response;
+    }
+}
+
+namespace {
+
+// Failures a later attempt can get past: the connection or the transfer broke
+// or stalled. Anything else (a malformed URL, an unsupported protocol, a bad
+// option) fails the same way every time.
+bool transient(CURLcode res) {
+    switch (res) {
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_RECV_ERROR:
+    case CURLE_SEND_ERROR:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_GOT_NOTHING: // the server closed the connection without a reply
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+TransferResult classify_transfer(CURL* curl, CURLcode res) {
+    TransferResult result;
+    if (res != CURLE_OK) {
+        result.outcome = transient(res) ? FetchOutcome::NetworkError : FetchOutcome::Rejected;
+        return result;
+    }
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 200 && status < 300)
+        result.outcome = FetchOutcome::Ok;
+    else if (status == 429 || status == 503)
+        result.outcome = FetchOutcome::Throttled;
+    else if (status >= 500)
+        result.outcome = FetchOutcome::ServerError;
+    else
+        result.outcome = FetchOutcome::Rejected;
+
+    if (result.outcome == FetchOutcome::Throttled) {
+        curl_off_t retry_after = 0;
+        if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK)
+            result.retry_after = retry_after;
+    }
+    return result;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "rate_controller.h"
+#include "telemetry.h"
+
+#include <curl/curl.h>
+#include <mutex>
+#include <string>
+
+// Updated service URL; override with --service <url>
+const std::string DEFAULT_SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
+
+// Callback function for writing response data
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output);
+
+// Function to HTTP encode parts of URLs. for instance, replace spaces with '%20' for URLs
+std::string url_encode(CURL* curl, const std::string& input);
+
+// Process-wide CURLSH so every handle, in every thread, shares one DNS cache,
+// one pool of keep-alive connections and one TLS session cache.
+class CurlShare {
+public:
+    CurlShare();
+    ~CurlShare();
+
+    CurlShare(const CurlShare&) = delete;
+    CurlShare& operator=(const CurlShare&) = delete;
+
+    CURLSH* get() const { return share; }
+
+private:
+    static void lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlock(CURL* handle, curl_lock_data data, void* userptr);
+
+    CURLSH* share;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+};
+
+// What every handle of one crawl shares: where requests go, the CURLSH caches,
+// the flow controller and the telemetry sink. Without a controller fetches are
+// tried once; without telemetry nothing is measured.
+struct FetchContext {
+    std::string service_url = DEFAULT_SERVICE_URL;
+    CurlShare* share = nullptr;
+    RateController* rate = nullptr;
+    Telemetry* telemetry = nullptr;
+};
+
+// Service and flow-control options taken by every crawler
+struct FetchOptions {
+    std::string service_url = DEFAULT_SERVICE_URL;
+    RateController::Options rate;
+
+    static const char* usage() { return "[--service <url>] [--max-rate <req/s>] [--retries <n>]"; }
+
+    // Consume argv[i] (and its value) if it is a fetch option. Throws
+    // invalid_argument on a missing or malformed value.
+    bool parse(int argc, char* argv[], int& i);
+};
+
+// A program's fetch setup, held for as long as it fetches: libcurl's global
+// state, the CurlShare and RateController every handle uses, and the
+// FetchContext that points at them.
+class FetchScope {
+public:
+    FetchScope(const FetchOptions& options, Telemetry* telemetry);
+
+    FetchScope(const FetchScope&) = delete;
+    FetchScope& operator=(const FetchScope&) = delete;
+
+    const FetchContext& context() const { return fetch_context; }
+    RateController& rate() { return controller; }
+
+private:
+    struct CurlGlobal {
+        CurlGlobal() { curl_global_init(CURL_GLOBAL_ALL); }
+        ~CurlGlobal() { curl_global_cleanup(); }
+    };
+
+    // declared first so it is torn down last: the DNS, connection and TLS
+    // caches must go before curl_global_cleanup
+    CurlGlobal global;
+    CurlShare share;
+    RateController controller;
+    FetchContext fetch_context;
+};
+
+// Request headers shared by all handles; built once, freed by the caller.
+struct curl_slist* default_headers();
+
+// Set the options that are the same for every request on this handle,
+// including connect/transfer timeouts so a stalled request becomes a retry.
+// Only CURLOPT_URL (and CURLOPT_WRITEDATA if the buffer moves) change later.
+void configure_handle(CURL* curl, CurlShare* share, struct curl_slist* headers, std::string* response);
+
+// A persistent keep-alive handle. Options and headers are set once in the
+// constructor; each fetch only swaps the URL and reuses the response buffer.
+class HttpClient {
+public:
+    explicit HttpClient(const FetchContext& context);
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // GET <service_url><node>, going through the context's RateController and
+    // retrying throttled or failed requests with backoff. If every attempt
+    // fails, logs it, records the node as failed and returns "{}".
+    // The buffer is reused by the next fetch; callers may parse it in place.
+    std::string& fetch_neighbors(const std::string& node);
+
+    // whether the last fetch completed with a 2xx response
+    bool ok() const { return succeeded; }
+
+    CURL* handle() const { return curl; }
+
+private:
+    const FetchContext& context;
+    CURL* curl;
+    struct curl_slist* headers;
+    std::string response;
+    bool succeeded = false;
+};
+
+// How a finished transfer ended, and the Retry-After it carried (seconds, 0 if none)
+struct TransferResult {
+    FetchOutcome outcome;
+    double retry_after = 0;
+};
+TransferResult classify_transfer(CURL* curl, CURLcode res);
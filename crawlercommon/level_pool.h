@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers for level-synchronous loops, started once and parked
+// between rounds, so a level costs one wake-up instead of creating and joining
+// a thread per worker.
+//
+// run(n, item) hands the indices of a round out one at a time from a shared
+// atomic cursor: a worker that draws a slow item simply takes fewer of the
+// rest, instead of a fixed chunk making it the straggler of the whole round.
+// Inside an item, split() fans a large piece of work (a hub node's neighbor
+// list) out in slices: idle workers and those between items take slices off a
+// shared list, and the splitting worker helps until every slice is done.
+class LevelPool {
+public:
+    // item(worker, i); returns false to stop handing out indices this round
+    using Item = std::function<bool(int worker, size_t i)>;
+    // piece(worker, begin, end) for one slice of a split
+    using Piece = std::function<void(int worker, size_t begin, size_t end)>;
+
+    explicit LevelPool(int workers) : workers(std::max(1, workers)) {
+        for (int w = 0; w < this->workers; ++w)
+            threads.emplace_back([this, w] { worker(w); });
+    }
+
+    ~LevelPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    LevelPool(const LevelPool&) = delete;
+    LevelPool& operator=(const LevelPool&) = delete;
+
+    int size() const { return workers; }
+
+    // Call item(worker, i) for i in [0, n) and block until every started item
+    // has finished. The first exception an item throws stops the round and is
+    // rethrown here.
+    void run(size_t n, const Item& item) {
+        if (n == 0)
+            return;
+        std::unique_lock<std::mutex> lock(m);
+        body = &item;
+        count = n;
+        cursor = 0;
+        stopped = false;
+        idle = 0;
+        error = nullptr;
+        ++round;
+        wake.notify_all();
+        done.wait(lock, [&] { return finished == round; });
+        body = nullptr;
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // From inside an item on `worker`: call piece over [0, n) in slices of
+    // `grain`, on this worker and any free ones, and return once all slices
+    // are done. Rethrows the first exception a slice threw. piece must not
+    // split again.
+    void split(int worker, size_t n, size_t grain, const Piece& piece) {
+        if (n == 0)
+            return;
+        Split s{&piece, n, std::max<size_t>(1, grain), 0, 0, nullptr};
+        s.left = (n + s.grain - 1) / s.grain;
+        std::unique_lock<std::mutex> lock(m);
+        splits.push_back(&s);
+        pending++;
+        wake.notify_all();
+
+        Slice slice;
+        while (claim(slice))
+            run_slice(worker, slice, lock);
+        done.wait(lock, [&] { return s.left == 0; });
+        splits.erase(std::find(splits.begin(), splits.end(), &s));
+        if (s.error)
+            std::rethrow_exception(s.error);
+    }
+
+private:
+    struct Split {
+        const Piece* piece;
+        size_t n;
+        size_t grain;
+        size_t next = 0; // first unclaimed index
+        size_t left = 0; // slices not finished yet
+        std::exception_ptr error;
+    };
+    struct Slice {
+        Split* split;
+        size_t begin, end;
+    };
+
+    // Claim the next slice of any split; caller holds m.
+    bool claim(Slice& slice) {
+        for (Split* s : splits) {
+            if (s->next >= s->n)
+                continue;
+            slice = {s, s->next, std::min(s->n, s->next + s->grain)};
+            s->next = slice.end;
+            if (s->next >= s->n)
+                pending--;
+            return true;
+        }
+        return false;
+    }
+
+    // Run a claimed slice with m released; lock is held again on return.
+    void run_slice(int w, const Slice& slice, std::unique_lock<std::mutex>& lock) {
+        lock.unlock();
+        std::exception_ptr e;
+        try {
+            (*slice.split->piece)(w, slice.begin, slice.end);
+        } catch (...) {
+            e = std::current_exception();
+        }
+        lock.lock();
+        if (e && !slice.split->error)
+            slice.split->error = e;
+        // the owner frees the split once left is 0, so this is the last touch
+        if (--slice.split->left == 0)
+            done.notify_all();
+    }
+
+    void worker(int w) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            wake.wait(lock, [&] { return quit || round != seen; });
+            if (quit)
+                return;
+            seen = round;
+            const Item& item = *body;
+            size_t n = count;
+            lock.unlock();
+
+            // items off the cursor, taking split slices first whenever there are any
+            while (true) {
+                if (pending.load(std::memory_order_relaxed) > 0) {
+                    Slice slice;
+                    lock.lock();
+                    if (claim(slice))
+                        run_slice(w, slice, lock);
+                    lock.unlock();
+                    continue;
+                }
+                if (stopped.load(std::memory_order_relaxed))
+                    break;
+                size_t i = cursor.fetch_add(1, std::memory_order_relaxed);
+                if (i >= n)
+                    break;
+                try {
+                    if (!item(w, i))
+                        stopped = true;
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(m);
+                    if (!error)
+                        error = std::current_exception();
+                    stopped = true;
+                }
+            }
+
+            // out of items: help with splits until every worker is out too
+            lock.lock();
+            if (++idle == workers) {
+                finished = seen;
+                done.notify_all();
+                wake.notify_all();
+            }
+            while (finished != seen) {
+                Slice slice;
+                if (claim(slice))
+                    run_slice(w, slice, lock);
+                else
+                    wake.wait(lock);
+            }
+        }
+    }
+
+    int workers;
+    std::vector<std::thread> threads;
+
+    std::mutex m;
+    std::condition_variable wake; // a round started, a split was posted, or quit
+    std::condition_variable done; // a round or a split finished
+    const Item* body = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> cursor{0};
+    std::atomic<bool> stopped{false};
+    int idle = 0;
+    uint64_t round = 0;
+    uint64_t finished = 0;
+    bool quit = false;
+    std::exception_ptr error;
+    std::vector<Split*> splits;
+    std::atomic<int> pending{0}; // splits with unclaimed slices
+};
@@ -0,0 +1,195 @@
+#include "multi_fetcher.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <queue>
+#include <thread>
+
+using namespace std;
+
+MultiFetcher::MultiFetcher(int max_in_flight, int loop_threads, const FetchContext& context) : context(context) {
+    loop_threads = std::max(1, loop_threads);
+    max_in_flight = std::max(loop_threads, max_in_flight);
+    headers = default_headers();
+
+    loops.resize(loop_threads);
+    for (int l = 0; l < loop_threads; ++l) {
+        Loop& loop = loops[l];
+        int slots = max_in_flight / loop_threads + (l < max_in_flight % loop_threads ? 1 : 0);
+        loop.multi = curl_multi_init();
+        // keep one idle connection per slot so the next level can reuse them
+        curl_multi_setopt(loop.multi, CURLMOPT_MAXCONNECTS, (long)slots);
+        loop.transfers.resize(slots);
+        for (auto& t : loop.transfers) {
+            t.curl = curl_easy_init();
+            configure_handle(t.curl, context.share, headers, &t.response);
+            curl_easy_setopt(t.curl, CURLOPT_PRIVATE, &t);
+        }
+    }
+}
+
+MultiFetcher::~MultiFetcher() {
+    for (auto& loop : loops) {
+        for (auto& t : loop.transfers)
+            curl_easy_cleanup(t.curl);
+        curl_multi_cleanup(loop.multi);
+    }
+    curl_slist_free_all(headers);
+}
+
+void MultiFetcher::fetch_all(size_t count, const NodeName& name_of, const Callback& on_response,
+                             const atomic<bool>* stop) {
+    atomic<size_t> cursor(0);
+    vector<exception_ptr> errors(loops.size());
+    vector<thread> extra;
+
+    auto run = [&](size_t l) {
+        try {
+            run_loop(l, count, name_of, cursor, on_response, stop);
+        } catch (...) {
+            errors[l] = current_exception();
+        }
+    };
+
+    for (size_t l = 1; l < loops.size(); ++l)
+        extra.emplace_back(run, l);
+    run(0);
+    for (auto& t : extra)
+        t.join();
+
+    for (auto& e : errors)
+        if (e)
+            rethrow_exception(e);
+}
+
+void MultiFetcher::run_loop(int l, size_t count, const NodeName& name_of, atomic<size_t>& cursor,
+                            const Callback& on_response, const atomic<bool>* stop) {
+    using Clock = chrono::steady_clock;
+    Loop& loop = loops[l];
+    RateController* rate = context.rate;
+    vector<Transfer*> idle;
+    for (auto& t : loop.transfers)
+        idle.push_back(&t);
+    size_t active = 0;
+    bool exhausted = false;
+
+    // requests waiting out a backoff or for the controller to admit them
+    struct Job {
+        Clock::time_point due;
+        size_t index;
+        int attempt;
+        bool operator>(const Job& o) const { return due > o.due; }
+    };
+    priority_queue<Job, vector<Job>, greater<Job>> waiting;
+    auto after = [](double seconds) {
+        return Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    };
+
+    try {
+        while (true) {
+            // the caller has what it needs: start nothing new, not even retries
+            if (stop && stop->load(memory_order_relaxed)) {
+                exhausted = true;
+                waiting = {};
+            }
+
+            // top up while this loop has free slots and the controller admits more
+            Clock::time_point now = Clock::now();
+            while (!idle.empty()) {
+                Job job{now, 0, 0};
+                if (!waiting.empty() && waiting.top().due <= now) {
+                    job = waiting.top();
+                    waiting.pop();
+                } else if (!exhausted) {
+                    job.index = cursor.fetch_add(1);
+                    if (job.index >= count) {
+                        exhausted = true;
+                        break;
+                    }
+                } else {
+                    break;
+                }
+
+                double wait = 0;
+                if (rate && !rate->try_acquire(wait)) {
+                    job.due = after(wait);
+                    waiting.push(job);
+                    break;
+                }
+
+                Transfer* t = idle.back();
+                idle.pop_back();
+                t->index = job.index;
+                t->attempt = job.attempt;
+                t->response.clear();
+                string url = context.service_url + url_encode(t->curl, name_of(job.index));
+                curl_easy_setopt(t->curl, CURLOPT_URL, url.c_str());
+                t->sent = Clock::now();
+                if (context.telemetry)
+                    context.telemetry->request_started();
+                curl_multi_add_handle(loop.multi, t->curl);
+                ++active;
+            }
+            if (active == 0 && waiting.empty() && exhausted)
+                break;
+
+            int running = 0;
+            curl_multi_perform(loop.multi, &running);
+
+            CURLMsg* msg;
+            int queued = 0;
+            while ((msg = curl_multi_info_read(loop.multi, &queued))) {
+                if (msg->msg != CURLMSG_DONE)
+                    continue;
+                Transfer* t = nullptr;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&t);
+                CURLcode res = msg->data.result;
+                TransferResult result = classify_transfer(t->curl, res);
+                curl_multi_remove_handle(loop.multi, t->curl);
+                --active;
+                idle.push_back(t);
+
+                auto latency = Clock::now() - t->sent;
+                if (context.telemetry)
+                    context.telemetry->request_finished(chrono::duration_cast<chrono::nanoseconds>(latency).count(),
+                                                        t->response.size(), result.outcome == FetchOutcome::Ok);
+                if (rate) {
+                    rate->release(result.outcome, chrono::duration<double>(latency).count(), result.retry_after);
+                    if (retryable(result.outcome) && t->attempt < rate->options().max_retries) {
+                        waiting.push({after(rate->retry_delay(t->attempt, result.retry_after)), t->index,
+                                      t->attempt + 1});
+                        continue;
+                    }
+                }
+
+                if (res != CURLE_OK)
+                    cerr << "CURL error: " << curl_easy_strerror(res) << endl;
+                if (retryable(result.outcome)) {
+                    cerr << "Giving up on " << name_of(t->index) << " after " << t->attempt + 1 << " attempts" << endl;
+                    if (rate)
+                        rate->record_failure(name_of(t->index));
+                }
+                bool ok = result.outcome == FetchOutcome::Ok;
+                if (!ok)
+                    t->response = "{}";
+                on_response(t->index, t->response, ok, l);
+            }
+
+            // sleep until a transfer finishes or the next waiting request is due;
+            // slots freed by other loops wake nobody, so re-check those often
+            long timeout = 1000;
+            if (!waiting.empty()) {
+                auto due = chrono::duration_cast<chrono::milliseconds>(waiting.top().due - Clock::now()).count();
+                timeout = std::clamp<long>(due, 5, 1000);
+            }
+            if (running > 0 || !waiting.empty())
+                curl_multi_poll(loop.multi, nullptr, 0, timeout, nullptr);
+        }
+    } catch (...) {
+        // leave the multi handle empty so the fetcher stays usable
+        for (auto& t : loop.transfers)
+            curl_multi_remove_handle(loop.multi, t.curl);
+        throw;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "http_client.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Event-driven fetch engine: each loop thread drives one curl_multi handle with
+// many transfers in flight, instead of one OS thread blocking per request.
+// With a RateController in the context, new transfers start only when it
+// admits them and throttled or failed ones are re-queued after a backoff,
+// without blocking the loop.
+class MultiFetcher {
+public:
+    // name of the i-th node of a batch
+    using NodeName = std::function<const std::string&(size_t i)>;
+    // called from event loop `loop` as the i-th transfer completes; ok is false
+    // for transfer errors and non-2xx responses. response may be parsed in
+    // place; its buffer is reused by the next transfer on that slot.
+    using Callback = std::function<void(size_t i, std::string& response, bool ok, int loop)>;
+
+    MultiFetcher(int max_in_flight, int loop_threads, const FetchContext& context);
+    ~MultiFetcher();
+
+    MultiFetcher(const MultiFetcher&) = delete;
+    MultiFetcher& operator=(const MultiFetcher&) = delete;
+
+    int loop_count() const { return loops.size(); }
+
+    // Fetch nodes 0..count-1, calling on_response as each one completes. Nodes
+    // that fail every attempt report "{}" like fetch_neighbors. Returns when
+    // all are done, or once *stop is set and the transfers in flight finish.
+    void fetch_all(size_t count, const NodeName& name_of, const Callback& on_response,
+                   const std::atomic<bool>* stop = nullptr);
+
+private:
+    struct Transfer {
+        CURL* curl = nullptr;
+        size_t index = 0;
+        int attempt = 0;
+        std::chrono::steady_clock::time_point sent;
+        std::string response;
+    };
+
+    struct Loop {
+        CURLM* multi = nullptr;
+        std::vector<Transfer> transfers;
+    };
+
+    void run_loop(int l, size_t count, const NodeName& name_of, std::atomic<size_t>& cursor,
+                  const Callback& on_response, const std::atomic<bool>* stop);
+
+    const FetchContext& context;
+    struct curl_slist* headers = nullptr;
+    std::vector<Loop> loops;
+};
@@ -0,0 +1,206 @@
+#include "neighbor_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = {'N', 'B', 'R', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t VERSION = 1;
+const uint64_t HEADER_SIZE = 16;
+const uint64_t MIN_MAPPING = 64ull << 20;
+
+uint32_t read_u32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+int64_t read_i64(const char* p) {
+    int64_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+void put(string& buf, const void* p, size_t n) {
+    buf.append(static_cast<const char*>(p), n);
+}
+
+} // namespace
+
+NeighborCache::NeighborCache(const string& path, Mode mode, long ttl_seconds)
+    : path(path), mode(mode), ttl(ttl_seconds) {
+    fd = mode == ReadOnly ? open(path.c_str(), O_RDONLY) : open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw runtime_error("Cannot open neighbor cache: " + path);
+
+    struct stat st;
+    fstat(fd, &st);
+    uint64_t size = st.st_size;
+
+    if (size == 0 && mode == ReadWrite) {
+        char header[HEADER_SIZE] = {};
+        memcpy(header, MAGIC, sizeof MAGIC);
+        memcpy(header + 8, &VERSION, sizeof VERSION);
+        if (pwrite(fd, header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE)
+            throw runtime_error("Cannot write neighbor cache header: " + path);
+        size = HEADER_SIZE;
+    }
+    if (size < HEADER_SIZE) {
+        close(fd);
+        throw runtime_error("Not a neighbor cache file: " + path);
+    }
+
+    file_size = size;
+    map_file(size);
+    if (memcmp(data, MAGIC, sizeof MAGIC) != 0 || read_u32(data + 8) != VERSION) {
+        munmap((void*)data, mapped);
+        close(fd);
+        throw runtime_error("Not a neighbor cache file: " + path);
+    }
+
+    // a crawl killed mid-append can leave a torn record; drop it
+    file_size = scan(HEADER_SIZE);
+    if (file_size < size && mode == ReadWrite && ftruncate(fd, file_size) != 0)
+        throw runtime_error("Cannot truncate neighbor cache: " + path);
+}
+
+NeighborCache::~NeighborCache() {
+    if (data)
+        munmap((void*)data, mapped);
+    if (fd >= 0)
+        close(fd);
+}
+
+// Map at least min_length bytes. The mapping runs past end of file so appends
+// only need a remap when they outgrow it; we never touch bytes past file_size.
+void NeighborCache::map_file(uint64_t min_length) {
+    uint64_t length = std::max(MIN_MAPPING, mapped);
+    while (length < min_length)
+        length *= 2;
+    if (data)
+        munmap((void*)data, mapped);
+    void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        throw runtime_error("Cannot mmap neighbor cache: " + path);
+    data = static_cast<const char*>(p);
+    mapped = length;
+}
+
+// Index every complete record from `from` to end of file; returns the end of
+// the last complete record.
+uint64_t NeighborCache::scan(uint64_t from) {
+    uint64_t pos = from;
+    while (pos + RECORD_HEADER <= file_size) {
+        uint32_t key_len = read_u32(data + pos);
+        uint32_t count = read_u32(data + pos + 4);
+        int64_t fetched_at = read_i64(data + pos + 8);
+        uint64_t end = pos + RECORD_HEADER + key_len;
+        if (end > file_size)
+            break;
+        if (count != TOMBSTONE) {
+            for (uint32_t i = 0; i < count && end <= file_size; ++i)
+                end += (end + 4 <= file_size) ? 4 + read_u32(data + end) : 4;
+            if (end > file_size)
+                break;
+        }
+        index[string(data + pos + RECORD_HEADER, key_len)] = {pos, fetched_at, count == TOMBSTONE};
+        pos = end;
+    }
+    return pos;
+}
+
+const char* NeighborCache::find_record(const string& node) {
+    auto it = index.find(node);
+    if (it == index.end() || it->second.tombstone ||
+        (ttl > 0 && mode == ReadWrite && time(nullptr) - it->second.fetched_at > ttl)) {
+        miss_count++;
+        return nullptr;
+    }
+    hit_count++;
+    return data + it->second.offset;
+}
+
+bool NeighborCache::lookup(const string& node, vector<string>& out) {
+    out.clear();
+    return lookup_each(node, [&](string_view name) { out.emplace_back(name); });
+}
+
+void NeighborCache::store(const string& node, const vector<string>& neighbors) {
+    if (mode == ReadOnly)
+        return;
+    append(node, neighbors.size(), &neighbors);
+}
+
+void NeighborCache::invalidate(const string& node) {
+    if (mode == ReadOnly)
+        return;
+    append(node, TOMBSTONE, nullptr);
+}
+
+void NeighborCache::append(const string& node, uint32_t count, const vector<string>* neighbors) {
+    string record;
+    uint32_t key_len = node.size();
+    int64_t now = time(nullptr);
+    put(record, &key_len, 4);
+    put(record, &count, 4);
+    put(record, &now, 8);
+    record += node;
+    if (neighbors) {
+        for (const auto& n : *neighbors) {
+            uint32_t len = n.size();
+            put(record, &len, 4);
+            record += n;
+        }
+    }
+
+    unique_lock<shared_mutex> lock(m);
+    if (pwrite(fd, record.data(), record.size(), file_size) != (ssize_t)record.size())
+        throw runtime_error("Cannot append to neighbor cache: " + path);
+    uint64_t offset = file_size;
+    file_size += record.size();
+    if (file_size > mapped)
+        map_file(file_size);
+    index[node] = {offset, now, count == TOMBSTONE};
+}
+
+size_t NeighborCache::size() const {
+    shared_lock<shared_mutex> lock(m);
+    return index.size();
+}
+
+bool CacheOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt == "--offline") {
+        offline = true;
+        return true;
+    }
+    if (opt != "--cache" && opt != "--cache-ttl")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--cache")
+        path = argv[++i];
+    else
+        ttl = stol(argv[++i]);
+    return true;
+}
+
+unique_ptr<NeighborCache> CacheOptions::open() const {
+    if (path.empty()) {
+        if (offline)
+            throw runtime_error("--offline needs --cache <file>");
+        return nullptr;
+    }
+    return make_unique<NeighborCache>(path, offline ? NeighborCache::ReadOnly : NeighborCache::ReadWrite, ttl);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Persistent adjacency store keyed by node name, backed by an append-only,
+// memory-mapped file.
+//
+// Layout: a 16-byte header ("NBRCACHE", u32 version, u32 reserved) followed by
+// records of
+//   u32 key_len, u32 count, i64 fetched_at (unix seconds), key bytes,
+//   count x (u32 len, name bytes)
+// A later record for a key supersedes earlier ones, so updates and
+// invalidations are plain appends. count == TOMBSTONE marks an invalidated key.
+class NeighborCache {
+public:
+    enum Mode { ReadWrite, ReadOnly };
+
+    // ttl_seconds == 0 keeps entries forever. In ReadOnly ("offline") mode the
+    // file is never written and stale entries are still served.
+    NeighborCache(const std::string& path, Mode mode, long ttl_seconds = 0);
+    ~NeighborCache();
+
+    NeighborCache(const NeighborCache&) = delete;
+    NeighborCache& operator=(const NeighborCache&) = delete;
+
+    // true on a usable hit, with the cached neighbors in out
+    bool lookup(const std::string& node, std::vector<std::string>& out);
+
+    // On a usable hit, call emit(string_view) for each cached neighbor straight
+    // out of the mapping and return true. emit must not call back into the cache.
+    template <class Emit>
+    bool lookup_each(const std::string& node, Emit emit);
+
+    // write-through after a successful fetch; ignored when offline
+    void store(const std::string& node, const std::vector<std::string>& neighbors);
+
+    // drop a node so the next lookup misses; ignored when offline
+    void invalidate(const std::string& node);
+
+    bool offline() const { return mode == ReadOnly; }
+    size_t size() const;
+    size_t hits() const { return hit_count; }
+    size_t misses() const { return miss_count; }
+
+private:
+    static const uint32_t TOMBSTONE = 0xffffffffu;
+    static const uint64_t RECORD_HEADER = 16; // key_len, count, fetched_at
+
+    struct Entry {
+        uint64_t offset;
+        int64_t fetched_at;
+        bool tombstone;
+    };
+
+    // record for a usable hit, or nullptr; caller holds m shared
+    const char* find_record(const std::string& node);
+    void map_file(uint64_t min_length);
+    uint64_t scan(uint64_t from);
+    void append(const std::string& node, uint32_t count, const std::vector<std::string>* neighbors);
+
+    std::string path;
+    Mode mode;
+    long ttl;
+    int fd = -1;
+
+    mutable std::shared_mutex m;
+    const char* data = nullptr;
+    uint64_t mapped = 0;    // length of the mapping, may run past end of file
+    uint64_t file_size = 0; // bytes of complete records, always <= mapped
+    std::unordered_map<std::string, Entry> index;
+
+    std::atomic<size_t> hit_count{0};
+    std::atomic<size_t> miss_count{0};
+};
+
+template <class Emit>
+bool NeighborCache::lookup_each(const std::string& node, Emit emit) {
+    std::shared_lock<std::shared_mutex> lock(m);
+    const char* p = find_record(node);
+    if (!p)
+        return false;
+
+    uint32_t key_len, count, len;
+    memcpy(&key_len, p, 4);
+    memcpy(&count, p + 4, 4);
+    p += RECORD_HEADER + key_len;
+    for (uint32_t i = 0; i < count; ++i) {
+        memcpy(&len, p, 4);
+        emit(std::string_view(p + 4, len));
+        p += 4 + len;
+    }
+    return true;
+}
+
+// Cache-first neighbor walk used by all crawlers: stream a hit straight from
+// the cache, otherwise run fetch(emit) -> bool and write a successful result
+// through. Offline, a miss yields no neighbors. A null cache just fetches.
+template <class Fetch, class Emit>
+void for_each_neighbor(NeighborCache* cache, const std::string& node, Fetch fetch, Emit emit) {
+    if (!cache) {
+        fetch(emit);
+        return;
+    }
+    if (cache->lookup_each(node, emit) || cache->offline())
+        return;
+
+    std::vector<std::string> fetched;
+    bool ok = fetch([&](std::string_view name) {
+        fetched.emplace_back(name);
+        emit(name);
+    });
+    if (ok)
+        cache->store(node, fetched);
+}
+
+// --cache <file>, --cache-ttl <seconds> and --offline, shared by the crawler CLIs
+struct CacheOptions {
+    std::string path;
+    long ttl = 0;
+    bool offline = false;
+
+    static const char* usage() { return "[--cache <file>] [--cache-ttl <seconds>] [--offline]"; }
+
+    // Consume argv[i] (and its value) if it is a cache option. Throws
+    // invalid_argument on a missing or malformed value.
+    bool parse(int argc, char* argv[], int& i);
+
+    // null when no --cache was given; throws runtime_error if the file can't be used
+    std::unique_ptr<NeighborCache> open() const;
+};
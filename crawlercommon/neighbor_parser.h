@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "rapidjson/error/error.h"
+
+#ifdef RAPIDJSON_READER_H_
+#error "include neighbor_parser.h before rapidjson/reader.h so parse errors throw"
+#endif
+
+struct ParseException : std::runtime_error, rapidjson::ParseResult {
+    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) :
+        std::runtime_error(msg),
+        rapidjson::ParseResult(code, offset) {}
+};
+
+#undef RAPIDJSON_PARSE_ERROR_NORETURN
+#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
+    throw ParseException(code, #code, offset)
+
+#include "rapidjson/reader.h"
+
+#include "http_client.h"
+
+// SAX extraction of the "neighbors" array from a service response. Names are
+// handed to the caller as views into the response buffer, which is parsed in
+// place, so there is no DOM and no per-name copy. Keep one parser per thread:
+// the Reader's parse stack is reused across responses.
+class NeighborParser {
+public:
+    // Parse body in place (it is modified) and call emit(string_view) for every
+    // neighbor. Returns false if the body is not a JSON object; throws
+    // ParseException on malformed JSON.
+    template <class Emit>
+    bool parse(std::string& body, Emit emit) {
+        Handler<Emit> handler(emit);
+        rapidjson::InsituStringStream stream(&body[0]);
+        reader.Parse<rapidjson::kParseInsituFlag>(stream, handler);
+        return handler.saw_object;
+    }
+
+private:
+    template <class Emit>
+    struct Handler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Handler<Emit>> {
+        explicit Handler(Emit& emit) : emit(emit) {}
+
+        bool StartObject() {
+            if (depth == 0)
+                saw_object = true;
+            ++depth;
+            return true;
+        }
+        bool EndObject(rapidjson::SizeType) {
+            --depth;
+            return true;
+        }
+        bool Key(const char* str, rapidjson::SizeType len, bool) {
+            next_is_neighbors = depth == 1 && len == 9 && memcmp(str, "neighbors", 9) == 0;
+            return true;
+        }
+        bool StartArray() {
+            ++depth;
+            if (next_is_neighbors)
+                neighbors_depth = depth;
+            next_is_neighbors = false;
+            return true;
+        }
+        bool EndArray(rapidjson::SizeType) {
+            if (depth == neighbors_depth)
+                neighbors_depth = -1;
+            --depth;
+            return true;
+        }
+        bool String(const char* str, rapidjson::SizeType len, bool) {
+            if (depth == neighbors_depth)
+                emit(std::string_view(str, len));
+            next_is_neighbors = false;
+            return true;
+        }
+        bool Default() {
+            next_is_neighbors = false;
+            return true;
+        }
+
+        Emit& emit;
+        int depth = 0;
+        int neighbors_depth = -1;
+        bool next_is_neighbors = false;
+        bool saw_object = false;
+    };
+
+    rapidjson::Reader reader;
+};
+
+// One HttpClient plus its parser, for one worker thread.
+class NeighborFetcher {
+public:
+    explicit NeighborFetcher(const FetchContext& context) : client(context), telemetry(context.telemetry) {}
+
+    // Fetch node and stream its neighbor names to emit(string_view). Returns
+    // whether the fetch succeeded (a failed one emits nothing).
+    template <class Emit>
+    bool fetch(const std::string& node, Emit emit) {
+        std::string& body = client.fetch_neighbors(node);
+        ParseTimer timer(telemetry);
+        if (!parser.parse(body, emit))
+            std::cerr << "Invalid JSON object for: " << node << std::endl;
+        return client.ok();
+    }
+
+    HttpClient client;
+    NeighborParser parser;
+    Telemetry* telemetry;
+};
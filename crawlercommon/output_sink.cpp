@@ -0,0 +1,204 @@
+#include "output_sink.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = {'N', 'O', 'D', 'E', 'L', 'I', 'S', 'T'};
+const uint32_t VERSION = 1;
+
+void put_u32(string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+void put_json_string(string& out, string_view s) {
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 15];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+bool OutputSink::parse_format(const string& name, Format& format) {
+    if (name == "text")
+        format = Format::Text;
+    else if (name == "ndjson")
+        format = Format::Ndjson;
+    else if (name == "binary")
+        format = Format::Binary;
+    else
+        return false;
+    return true;
+}
+
+OutputSink::OutputSink(const string& path, Format format, size_t buffer_size)
+    : format(format), buffer_size(buffer_size) {
+    if (path == "-") {
+        fd = STDOUT_FILENO;
+    } else {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw runtime_error("Cannot create output file: " + path);
+        owns_fd = true;
+    }
+    filling.reserve(buffer_size + 4096);
+    flushing.reserve(buffer_size + 4096);
+    if (format == Format::Binary) {
+        filling.append(MAGIC, sizeof MAGIC);
+        put_u32(filling, VERSION);
+        put_u32(filling, 0);
+    }
+    writer = thread(&OutputSink::writer_loop, this);
+}
+
+OutputSink::~OutputSink() {
+    try {
+        close();
+    } catch (const exception&) {
+    }
+}
+
+void OutputSink::encode(string& out, string_view name, int depth) const {
+    switch (format) {
+    case Format::Text:
+        out += to_string(depth);
+        out += '\t';
+        out += name;
+        out += '\n';
+        break;
+    case Format::Ndjson:
+        out += "{\"node\":";
+        put_json_string(out, name);
+        out += ",\"depth\":";
+        out += to_string(depth);
+        out += "}\n";
+        break;
+    case Format::Binary:
+        put_u32(out, depth);
+        put_u32(out, name.size());
+        out += name;
+        break;
+    }
+}
+
+void OutputSink::write(string_view name, int depth) {
+    thread_local string scratch;
+    scratch.clear();
+    encode(scratch, name, depth);
+    append(scratch, depth, 1);
+}
+
+void OutputSink::append(const string& encoded, int depth, size_t count) {
+    unique_lock<mutex> lock(m);
+    if (closing)
+        throw logic_error("OutputSink::write after close");
+    // a full buffer waits for the writer to finish the previous one
+    space.wait(lock, [&] { return filling.size() < buffer_size || flushing.empty(); });
+    filling += encoded;
+    if (counts.size() <= size_t(depth))
+        counts.resize(depth + 1);
+    counts[depth] += count;
+    if (filling.size() >= buffer_size && flushing.empty()) {
+        filling.swap(flushing);
+        writer_wake.notify_one();
+    }
+}
+
+bool OutputSink::write_out(const string& bytes) {
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+void OutputSink::writer_loop() {
+    unique_lock<mutex> lock(m);
+    while (true) {
+        writer_wake.wait_for(lock, chrono::milliseconds(200), [&] { return !flushing.empty() || closing; });
+        // nothing handed over: push out whatever is there so readers keep up
+        if (flushing.empty())
+            filling.swap(flushing);
+        if (flushing.empty()) {
+            if (closing)
+                return;
+            continue;
+        }
+
+        lock.unlock();
+        bool ok = write_out(flushing);
+        lock.lock();
+        failed |= !ok;
+        flushing.clear();
+        space.notify_all();
+    }
+}
+
+void OutputSink::close() {
+    {
+        lock_guard<mutex> lock(m);
+        if (closing)
+            return;
+        closing = true;
+    }
+    writer_wake.notify_one();
+    writer.join();
+    if (owns_fd && ::close(fd) != 0)
+        failed = true;
+    if (failed)
+        throw runtime_error("Error writing crawl output");
+}
+
+vector<uint64_t> OutputSink::depth_counts() const {
+    lock_guard<mutex> lock(m);
+    return counts;
+}
+
+bool OutputOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt != "--output" && opt != "--format")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--output")
+        path = argv[++i];
+    else if (!OutputSink::parse_format(argv[++i], format))
+        throw invalid_argument(string("unknown --format ") + argv[i]);
+    return true;
+}
+
+unique_ptr<OutputSink> OutputOptions::open() const {
+    if (path.empty())
+        return nullptr;
+    return make_unique<OutputSink>(path, format);
+}
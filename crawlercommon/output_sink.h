@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Streams (node, depth) records to a file or stdout as the crawl discovers
+// them, instead of holding every level until the end.
+//
+// Crawl threads encode records into a large in-memory buffer; a writer thread
+// swaps it out and write()s it, at the latest every 200ms so readers of the
+// output see progress. If the writer falls a whole buffer behind, producers
+// wait, which bounds memory.
+//
+// Formats:
+//   text    "<depth>\t<name>\n"
+//   ndjson  {"node":"<name>","depth":<depth>}\n
+//   binary  "NODELIST" u32 version(1) u32 reserved, then per node
+//           u32 depth, u32 name_len, name bytes (little endian)
+class OutputSink {
+public:
+    enum class Format { Text, Ndjson, Binary };
+
+    // "text", "ndjson" or "binary"; false for anything else
+    static bool parse_format(const std::string& name, Format& format);
+
+    // path "-" writes to stdout. Throws runtime_error if the file can't be created.
+    OutputSink(const std::string& path, Format format, size_t buffer_size = 4 << 20);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // Thread-safe.
+    void write(std::string_view name, int depth);
+
+    // Write the ids in [first, last) with one buffer append; name_of(id) gives each name.
+    template <class It, class NameOf>
+    void write_all(It first, It last, int depth, NameOf name_of) {
+        if (first == last)
+            return;
+        thread_local std::string scratch;
+        scratch.clear();
+        size_t n = 0;
+        for (; first != last; ++first, ++n)
+            encode(scratch, name_of(*first), depth);
+        append(scratch, depth, n);
+    }
+
+    // Flush everything and stop the writer. Throws runtime_error if any write
+    // failed. Called by the destructor (which swallows the error).
+    void close();
+
+    // nodes written so far at each depth
+    std::vector<uint64_t> depth_counts() const;
+
+private:
+    void encode(std::string& out, std::string_view name, int depth) const;
+    void append(const std::string& encoded, int depth, size_t count);
+    void writer_loop();
+    bool write_out(const std::string& bytes);
+
+    int fd = -1;
+    bool owns_fd = false;
+    Format format;
+    size_t buffer_size;
+
+    mutable std::mutex m;
+    std::condition_variable writer_wake; // flushing has data, or closing
+    std::condition_variable space;       // flushing was written out
+    std::string filling;  // producers append here
+    std::string flushing; // the writer thread owns this while it is non-empty
+    std::vector<uint64_t> counts;
+    bool closing = false;
+    bool failed = false;
+    std::thread writer;
+};
+
+// --output <file|-> --format <text|ndjson|binary>, shared by the level clients
+struct OutputOptions {
+    std::string path;
+    OutputSink::Format format = OutputSink::Format::Text;
+
+    static const char* usage() { return "[--output <file|->] [--format text|ndjson|binary]"; }
+
+    // Consume argv[i] (and its value) if it is an output option. Throws
+    // invalid_argument on a missing or unknown value.
+    bool parse(int argc, char* argv[], int& i);
+
+    // null when no --output was given (the crawler prints its levels at the end)
+    std::unique_ptr<OutputSink> open() const;
+};
@@ -0,0 +1,150 @@
+#include "rate_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+RateController::RateController(const Options& options)
+    : opts(options),
+      limit(std::max(1, options.initial_limit)),
+      rate(options.max_rate),
+      last_refill(Clock::now()),
+      paused_until(Clock::now()),
+      last_decrease(Clock::now()),
+      rng(random_device{}()) {}
+
+void RateController::refill(Clock::time_point now) {
+    if (rate <= 0)
+        return;
+    double elapsed = chrono::duration<double>(now - last_refill).count();
+    // allow a burst of a quarter second worth of requests
+    tokens = std::min(std::max(1.0, rate / 4), tokens + elapsed * rate);
+    last_refill = now;
+}
+
+bool RateController::admit(Clock::time_point now, double& wait) {
+    if (now < paused_until) {
+        wait = chrono::duration<double>(paused_until - now).count();
+        return false;
+    }
+    if (in_flight >= std::max(1, int(limit))) {
+        wait = 0;
+        return false;
+    }
+    refill(now);
+    if (rate > 0 && tokens < 1) {
+        wait = (1 - tokens) / rate;
+        return false;
+    }
+    if (rate > 0)
+        tokens -= 1;
+    ++in_flight;
+    ++requests;
+    return true;
+}
+
+void RateController::acquire() {
+    unique_lock<mutex> lock(m);
+    while (true) {
+        double wait;
+        Clock::time_point now = Clock::now();
+        if (admit(now, wait))
+            return;
+        if (wait > 0)
+            cv.wait_until(lock, now + chrono::duration_cast<Clock::duration>(chrono::duration<double>(wait)));
+        else
+            cv.wait(lock);
+    }
+}
+
+bool RateController::try_acquire(double& wait) {
+    lock_guard<mutex> lock(m);
+    return admit(Clock::now(), wait);
+}
+
+bool RateController::decrease(Clock::time_point now, double factor) {
+    // one cut per round trip, or a burst of failures collapses the window
+    double window = std::max(0.05, latency_ewma);
+    if (chrono::duration<double>(now - last_decrease).count() < window)
+        return false;
+    last_decrease = now;
+    slow_start = false;
+    limit = std::max(1.0, limit * factor);
+    return true;
+}
+
+void RateController::release(FetchOutcome outcome, double latency, double retry_after) {
+    {
+        lock_guard<mutex> lock(m);
+        Clock::time_point now = Clock::now();
+        --in_flight;
+
+        if (outcome == FetchOutcome::Ok || outcome == FetchOutcome::Rejected) {
+            min_latency = min_latency == 0 ? latency : std::min(min_latency, latency);
+            latency_ewma = latency_ewma == 0 ? latency : 0.9 * latency_ewma + 0.1 * latency;
+
+            // queueing: well above the best latency seen, by more than jitter
+            if (latency_ewma > 3 * min_latency && latency_ewma - min_latency > 0.1)
+                decrease(now, 0.9);
+            else
+                limit = std::min<double>(opts.max_limit, limit + (slow_start ? 1 : 1 / limit));
+
+            if (rate > 0) {
+                // about max(1, rate/10) more requests/s every second
+                rate += std::max(1.0, rate / 10) / rate;
+                if (opts.max_rate > 0)
+                    rate = std::min(rate, opts.max_rate);
+            }
+        } else {
+            if (outcome == FetchOutcome::Throttled)
+                ++throttled;
+            else
+                ++errors;
+            // an explicit throttle halves the window; a stray error only trims it
+            bool cut = decrease(now, outcome == FetchOutcome::Throttled ? 0.5 : 0.75);
+
+            if (cut && outcome == FetchOutcome::Throttled) {
+                // fall back to half of what we were pushing through
+                double current = rate > 0 ? rate : limit / std::max(0.001, latency_ewma);
+                rate = std::max(1.0, current / 2);
+                if (opts.max_rate > 0)
+                    rate = std::min(rate, opts.max_rate);
+                tokens = std::min(tokens, 1.0);
+            }
+            if (retry_after > 0)
+                paused_until = std::max(paused_until,
+                    now + chrono::duration_cast<Clock::duration>(chrono::duration<double>(retry_after)));
+        }
+    }
+    cv.notify_all();
+}
+
+double RateController::retry_delay(int attempt, double retry_after) {
+    lock_guard<mutex> lock(m);
+    ++retries;
+    double cap = std::min(opts.max_delay, opts.base_delay * std::pow(2.0, attempt));
+    uniform_real_distribution<double> jitter(0, cap);
+    return std::max(retry_after, jitter(rng));
+}
+
+void RateController::record_failure(const string& node) {
+    lock_guard<mutex> lock(m);
+    failed.push_back(node);
+}
+
+void RateController::report(ostream& out) const {
+    lock_guard<mutex> lock(m);
+    if (throttled == 0 && errors == 0 && retries == 0)
+        return;
+    out << "Rate control: " << requests << " requests, " << throttled << " throttled, " << errors
+        << " errors, " << retries << " retries; final limit " << int(limit) << " in flight";
+    if (rate > 0)
+        out << ", " << rate << " req/s";
+    out << "\n";
+    if (!failed.empty()) {
+        out << "Gave up on " << failed.size() << " nodes (their neighbors are missing):\n";
+        for (const auto& node : failed)
+            out << "  " << node << "\n";
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// How one request ended, as far as flow control is concerned
+enum class FetchOutcome {
+    Ok,           // 2xx
+    Rejected,     // other 4xx, or a request curl can't make (bad URL...): retrying won't help
+    Throttled,    // 429 or 503: the service wants us to slow down
+    ServerError,  // other 5xx
+    NetworkError, // timeout, reset, refused, dropped...
+};
+
+inline bool retryable(FetchOutcome o) {
+    return o == FetchOutcome::Throttled || o == FetchOutcome::ServerError || o == FetchOutcome::NetworkError;
+}
+
+// AIMD flow control shared by every fetch of a crawl.
+//
+// Two knobs are adapted from what the service tells us:
+//  - limit: how many requests may be in flight. +1 per success until the
+//    first decrease (slow start), then +1 per window of successes; x0.9 when
+//    latency climbs well above the best seen (queueing), x0.75 on errors and
+//    x0.5 on throttling; at most one decrease per round trip.
+//  - rate: requests per second through a token bucket. Unlimited (or the
+//    user's cap) until the first throttle, then half the throughput we were
+//    getting (again at most once per round trip), growing back by
+//    max(1, rate/10) req/s every second.
+// A Retry-After pauses every caller until it has passed. Retries back off
+// exponentially with full jitter.
+class RateController {
+public:
+    struct Options {
+        int initial_limit = 16;
+        int max_limit = 1024;
+        double max_rate = 0;     // requests/s cap, 0 = none
+        int max_retries = 6;     // per request, after the first attempt
+        double base_delay = 0.25; // seconds, first backoff step
+        double max_delay = 60;   // seconds, backoff ceiling
+    };
+
+    explicit RateController(const Options& options);
+
+    // Block until a request may start, then count it as in flight.
+    void acquire();
+
+    // Non-blocking acquire for event loops. On false, wait holds the seconds
+    // until trying again makes sense (0 when waiting for an in-flight slot).
+    bool try_acquire(double& wait);
+
+    // Report a finished request started by acquire()/try_acquire().
+    void release(FetchOutcome outcome, double latency, double retry_after = 0);
+
+    // Seconds to wait before retry number `attempt` (0-based).
+    double retry_delay(int attempt, double retry_after);
+
+    const Options& options() const { return opts; }
+
+    // nodes whose fetch still failed after every retry
+    void record_failure(const std::string& node);
+
+    // End-of-crawl counters and the nodes that were given up on. Prints
+    // nothing if no request was ever throttled, failed or retried.
+    void report(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void refill(Clock::time_point now);
+    // true and counted in flight if a request may start now; else wait set
+    bool admit(Clock::time_point now, double& wait);
+    // multiplicative cut of limit; false if one already happened this round trip
+    bool decrease(Clock::time_point now, double factor);
+
+    Options opts;
+    mutable std::mutex m;
+    std::condition_variable cv;
+
+    double limit;
+    bool slow_start = true;
+    int in_flight = 0;
+    double rate;   // 0 = not rate limited
+    double tokens = 1;
+    Clock::time_point last_refill;
+    Clock::time_point paused_until;
+    Clock::time_point last_decrease;
+
+    double min_latency = 0;
+    double latency_ewma = 0;
+    std::mt19937 rng;
+
+    size_t requests = 0;
+    size_t throttled = 0;
+    size_t errors = 0;
+    size_t retries = 0;
+    std::vector<std::string> failed;
+};
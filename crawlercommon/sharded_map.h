@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+// Hash-sharded concurrent map. Each key maps to one of Shards independently
+// locked unordered_maps, so threads only contend when their keys land in the
+// same shard instead of serializing on one global mutex.
+template <class Key, class Value, class Hash = std::hash<Key>, size_t Shards = 64>
+class ShardedMap {
+    static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+public:
+    using Map = std::unordered_map<Key, Value, Hash>;
+
+    // Lock the shard that owns key and run f(map) on it; returns f's result.
+    template <class F>
+    auto with_shard(const Key& key, F f) {
+        Shard& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.m);
+        return f(s.map);
+    }
+
+    // Find key or insert make_value() for it as one atomic step. make_value
+    // runs under the shard lock. Returns the stored value and whether this
+    // call inserted it.
+    template <class Make>
+    std::pair<Value, bool> insert_if_absent(const Key& key, Make make_value) {
+        return with_shard(key, [&](Map& map) {
+            auto it = map.find(key);
+            if (it != map.end())
+                return std::make_pair(it->second, false);
+            Value v = make_value();
+            map.emplace(key, v);
+            return std::make_pair(v, true);
+        });
+    }
+
+    bool find(const Key& key, Value& out) const {
+        const Shard& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.m);
+        auto it = s.map.find(key);
+        if (it == s.map.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const Shard& s : shards) {
+            std::lock_guard<std::mutex> lock(s.m);
+            n += s.map.size();
+        }
+        return n;
+    }
+
+private:
+    // one shard per cache line pair so neighbouring locks don't false-share
+    struct alignas(128) Shard {
+        mutable std::mutex m;
+        Map map;
+    };
+
+    static size_t shard_index(const Key& key) {
+        // unordered_map buckets use the low bits of the hash; pick the shard
+        // from the high bits of a mixed copy so the two stay independent
+        uint64_t h = uint64_t(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+        return Shards == 1 ? 0 : size_t(h >> (64 - shard_bits()));
+    }
+
+    static constexpr unsigned shard_bits() {
+        unsigned b = 0;
+        while ((size_t(1) << b) < Shards)
+            ++b;
+        return b;
+    }
+
+    Shard& shard_for(const Key& key) { return shards[shard_index(key)]; }
+    const Shard& shard_for(const Key& key) const { return shards[shard_index(key)]; }
+
+    Shard shards[Shards];
+};
+
+// Concurrent set with an insert-if-absent API, built on the same sharding.
+template <class Key, class Hash = std::hash<Key>, size_t Shards = 64>
+class ShardedSet {
+public:
+    // true if key was absent and this call added it
+    bool insert(const Key& key) {
+        return map.insert_if_absent(key, [] { return true; }).second;
+    }
+
+    bool contains(const Key& key) const {
+        bool unused;
+        return map.find(key, unused);
+    }
+
+    size_t size() const { return map.size(); }
+
+private:
+    ShardedMap<Key, bool, Hash, Shards> map;
+};
@@ -0,0 +1,57 @@
+#include "string_interner.h"
+
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+StringInterner::StringInterner() : chunks(new atomic<string*>[MAX_CHUNKS]) {
+    for (size_t c = 0; c < MAX_CHUNKS; ++c)
+        chunks[c].store(nullptr, memory_order_relaxed);
+}
+
+StringInterner::~StringInterner() {
+    for (size_t c = 0; c < MAX_CHUNKS; ++c)
+        delete[] chunks[c].load(memory_order_relaxed);
+}
+
+// Slot for a freshly reserved id, allocating its chunk if this is the first
+// id in it. Several shards may race to allocate the same chunk.
+string& StringInterner::slot(NodeId id) {
+    atomic<string*>& c = chunks[id >> CHUNK_BITS];
+    string* chunk = c.load(memory_order_acquire);
+    if (!chunk) {
+        string* fresh = new string[CHUNK_MASK + 1];
+        if (c.compare_exchange_strong(chunk, fresh, memory_order_acq_rel))
+            chunk = fresh;
+        else
+            delete[] fresh; // lost the race; chunk now holds the winner's
+    }
+    return chunk[id & CHUNK_MASK];
+}
+
+NodeId StringInterner::intern(string_view name, bool* inserted) {
+    bool added = false;
+    NodeId id = ids.with_shard(name, [&](ShardedMap<string_view, NodeId>::Map& map) {
+        auto it = map.find(name);
+        if (it != map.end())
+            return it->second;
+
+        NodeId fresh = count.fetch_add(1, memory_order_acq_rel);
+        if (fresh == numeric_limits<NodeId>::max())
+            throw overflow_error("StringInterner: out of node ids");
+        string& s = slot(fresh);
+        s.assign(name.data(), name.size());
+        map.emplace(string_view(s), fresh);
+        added = true;
+        return fresh;
+    });
+
+    if (inserted)
+        *inserted = added;
+    return id;
+}
+
+bool StringInterner::find(string_view name, NodeId& id) const {
+    return ids.find(name, id);
+}
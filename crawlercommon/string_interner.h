@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "sharded_map.h"
+
+using NodeId = uint32_t;
+
+// Thread-safe map from node name to a dense 32-bit id, so BFS state can be
+// kept as integers and every name is stored exactly once.
+//
+// The name -> id index is hash-sharded, so concurrent interns of different
+// names rarely share a lock. Names live in fixed-size chunks that are
+// allocated on demand and never moved, so name(id) needs no lock once the id
+// has been handed out.
+class StringInterner {
+public:
+    StringInterner();
+    ~StringInterner();
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // id for name, adding it if new; *inserted tells whether this call added it
+    NodeId intern(std::string_view name, bool* inserted = nullptr);
+
+    // id for name without adding it; false if it was never interned
+    bool find(std::string_view name, NodeId& id) const;
+
+    const std::string& name(NodeId id) const {
+        return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & CHUNK_MASK];
+    }
+
+    // Number of ids handed out. Only walk 0..size() while no intern() is in
+    // flight: a slot is filled just after its id is reserved.
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+private:
+    static const unsigned CHUNK_BITS = 16;
+    static const NodeId CHUNK_MASK = (1u << CHUNK_BITS) - 1;
+    static const size_t MAX_CHUNKS = size_t(1) << (32 - CHUNK_BITS);
+
+    std::string& slot(NodeId id);
+
+    std::unique_ptr<std::atomic<std::string*>[]> chunks;
+    // keys view the names stored in chunks
+    mutable ShardedMap<std::string_view, NodeId> ids;
+    std::atomic<NodeId> count{0};
+};
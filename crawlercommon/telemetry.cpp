@@ -0,0 +1,219 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+thread_local uint64_t visit_ns_this_thread = 0;
+
+const double SAMPLE_INTERVAL = 0.25; // seconds
+
+double ms(uint64_t ns) {
+    return ns / 1e6;
+}
+
+} // namespace
+
+int LatencyHistogram::bucket(uint64_t ns) {
+    if (ns < SUB_BUCKETS)
+        return ns;
+    int e = 63 - __builtin_clzll(ns); // >= 4
+    return (e - 3) * SUB_BUCKETS + ((ns >> (e - 4)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucket_floor(int b) {
+    if (b < SUB_BUCKETS)
+        return b;
+    int e = b / SUB_BUCKETS + 3;
+    return uint64_t(SUB_BUCKETS + b % SUB_BUCKETS) << (e - 4);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[bucket(ns)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sum_ns.fetch_add(ns, memory_order_relaxed);
+    uint64_t seen = max_ns.load(memory_order_relaxed);
+    while (ns > seen && !max_ns.compare_exchange_weak(seen, ns, memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(q * n + 0.5));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+        seen += buckets[b].load(memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t high = b + 1 < BUCKETS ? bucket_floor(b + 1) : max();
+            return std::min(max(), (bucket_floor(b) + high) / 2);
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::write_json(ostream& out) const {
+    uint64_t n = count();
+    out << "{\"count\": " << n << ", \"mean_ms\": " << (n ? ms(sum()) / n : 0) << ", \"p50_ms\": "
+        << ms(percentile(0.5)) << ", \"p90_ms\": " << ms(percentile(0.9)) << ", \"p99_ms\": "
+        << ms(percentile(0.99)) << ", \"max_ms\": " << ms(max()) << ", \"total_ms\": " << ms(sum()) << "}";
+}
+
+Telemetry::Telemetry(double progress) : started(now_ns()) {
+    sampling = thread(&Telemetry::sampler, this, progress);
+}
+
+Telemetry::~Telemetry() {
+    stop();
+}
+
+void Telemetry::stop() {
+    {
+        lock_guard<mutex> lock(m);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    wake.notify_all();
+    if (sampling.joinable())
+        sampling.join();
+}
+
+void Telemetry::request_finished(uint64_t latency_ns, size_t n, bool ok) {
+    in_flight.fetch_sub(1, memory_order_relaxed);
+    requests.fetch_add(1, memory_order_relaxed);
+    if (!ok)
+        failed.fetch_add(1, memory_order_relaxed);
+    bytes.fetch_add(n, memory_order_relaxed);
+    request_latency.record(latency_ns);
+}
+
+void Telemetry::record_visit(uint64_t ns) {
+    visit.record(ns);
+    visit_ns_this_thread += ns;
+}
+
+uint64_t Telemetry::thread_visit_ns() {
+    return visit_ns_this_thread;
+}
+
+void Telemetry::record_expansion(int level, size_t neighbors, size_t discovered) {
+    nodes.fetch_add(discovered, memory_order_relaxed);
+    lock_guard<mutex> lock(m);
+    if (levels.size() <= size_t(level))
+        levels.resize(level + 1);
+    levels[level].expanded++;
+    levels[level].neighbors += neighbors;
+    levels[level].discovered += discovered;
+}
+
+void Telemetry::set_queue_depth(function<size_t()> queued) {
+    lock_guard<mutex> lock(m);
+    queue_depth = std::move(queued);
+}
+
+void Telemetry::take_sample(double t) {
+    // caller holds m
+    long queued = queue_depth ? long(queue_depth()) : -1;
+    samples.push_back({t, requests.load(memory_order_relaxed), nodes.load(memory_order_relaxed),
+                       in_flight.load(memory_order_relaxed), queued});
+}
+
+void Telemetry::sampler(double progress) {
+    unique_lock<mutex> lock(m);
+    auto next_sample = chrono::steady_clock::now();
+    auto next_progress = next_sample + chrono::duration_cast<chrono::steady_clock::duration>(
+                                           chrono::duration<double>(progress));
+    uint64_t last_requests = 0;
+    while (!stopping) {
+        next_sample += chrono::milliseconds(int(SAMPLE_INTERVAL * 1000));
+        wake.wait_until(lock, next_sample, [&] { return stopping; });
+        if (stopping)
+            break;
+        double t = ms(now_ns() - started) / 1000;
+        take_sample(t);
+
+        if (progress > 0 && chrono::steady_clock::now() >= next_progress) {
+            const Sample& s = samples.back();
+            double rate = (s.requests - last_requests) / progress;
+            last_requests = s.requests;
+            cerr << "[" << fixed << setprecision(1) << t << "s] " << s.nodes << " nodes, " << s.requests
+                 << " requests (" << setprecision(0) << rate << "/s), " << s.in_flight << " in flight";
+            if (s.queued >= 0)
+                cerr << ", " << s.queued << " queued";
+            cerr << ", p50 " << setprecision(1) << ms(request_latency.percentile(0.5)) << "ms\n"
+                 << defaultfloat;
+            next_progress += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(progress));
+        }
+    }
+}
+
+void Telemetry::write_report(const string& path, double wall_seconds) {
+    stop();
+    ofstream out(path);
+    if (!out)
+        throw runtime_error("Cannot write telemetry report: " + path);
+
+    lock_guard<mutex> lock(m);
+    out << "{\n  \"wall_seconds\": " << wall_seconds << ",\n  \"requests\": " << requests.load()
+        << ",\n  \"failed_requests\": " << failed.load() << ",\n  \"bytes_received\": " << bytes.load()
+        << ",\n  \"requests_per_s\": " << (wall_seconds > 0 ? requests.load() / wall_seconds : 0)
+        << ",\n  \"request_latency\": ";
+    request_latency.write_json(out);
+    out << ",\n  \"parse\": ";
+    parse.write_json(out);
+    out << ",\n  \"visit\": ";
+    visit.write_json(out);
+    out << ",\n  \"lock_wait\": ";
+    lock_wait.write_json(out);
+
+    out << ",\n  \"levels\": [";
+    for (size_t l = 0; l < levels.size(); ++l) {
+        const Level& lv = levels[l];
+        out << (l ? "," : "") << "\n    {\"level\": " << l << ", \"expanded\": " << lv.expanded
+            << ", \"neighbors\": " << lv.neighbors << ", \"discovered\": " << lv.discovered
+            << ", \"fan_out\": " << (lv.expanded ? double(lv.neighbors) / lv.expanded : 0)
+            << ", \"new_per_node\": " << (lv.expanded ? double(lv.discovered) / lv.expanded : 0) << "}";
+    }
+    out << "\n  ],\n  \"samples\": [";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const Sample& s = samples[i];
+        out << (i ? "," : "") << "\n    {\"t\": " << s.t << ", \"requests\": " << s.requests << ", \"nodes\": "
+            << s.nodes << ", \"in_flight\": " << s.in_flight;
+        if (s.queued >= 0)
+            out << ", \"queued\": " << s.queued;
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+bool TelemetryOptions::parse(int argc, char* argv[], int& i) {
+    string opt = argv[i];
+    if (opt != "--telemetry" && opt != "--progress")
+        return false;
+    if (i + 1 >= argc)
+        throw invalid_argument(opt + " needs a value");
+    if (opt == "--telemetry")
+        path = argv[++i];
+    else
+        progress = stod(argv[++i]);
+    return true;
+}
+
+unique_ptr<Telemetry> TelemetryOptions::open() const {
+    if (path.empty() && progress <= 0)
+        return nullptr;
+    return make_unique<Telemetry>(progress);
+}
+
+void TelemetryOptions::finish(Telemetry* telemetry, double wall_seconds) const {
+    if (telemetry && !path.empty())
+        telemetry->write_report(path, wall_seconds);
+}
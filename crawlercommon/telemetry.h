@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lock-free latency histogram in nanoseconds. Log-linear buckets, 16 per power
+// of two, so any percentile is within ~6% of the true value.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_ns.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_ns.load(std::memory_order_relaxed); }
+    // value at quantile q in [0, 1], 0 if empty
+    uint64_t percentile(double q) const;
+
+    // {"count":..,"mean_ms":..,"p50_ms":..,"p90_ms":..,"p99_ms":..,"max_ms":..,"total_ms":..}
+    void write_json(std::ostream& out) const;
+
+private:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 64 * SUB_BUCKETS;
+    static int bucket(uint64_t ns);
+    static uint64_t bucket_floor(int b);
+
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+// Crawl instrumentation: request latency and bytes, parse time, visited-set
+// update time, lock waits, per-level fan-out, and in-flight/queued work sampled
+// over time. Crawlers hold a Telemetry* that is null unless --telemetry or
+// --progress was given, so every probe costs one branch when it is off.
+class Telemetry {
+public:
+    // progress > 0 prints a status line to stderr every that many seconds
+    explicit Telemetry(double progress = 0);
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // fetch layer, once per attempt
+    void request_started() { in_flight.fetch_add(1, std::memory_order_relaxed); }
+    void request_finished(uint64_t latency_ns, size_t bytes, bool ok);
+
+    // time spent parsing one response, not counting the visit callbacks in it
+    void record_parse(uint64_t ns) { parse.record(ns); }
+    // one neighbor through the interner and visited set
+    void record_visit(uint64_t ns);
+    // waiting for a lock on shared crawl state (level lists)
+    void record_lock_wait(uint64_t ns) { lock_wait.record(ns); }
+
+    // one expanded node at `level`: how many neighbors it had, how many were new
+    void record_expansion(int level, size_t neighbors, size_t discovered);
+
+    // optional source for the "queued" column of samples and progress lines
+    void set_queue_depth(std::function<size_t()> queued);
+
+    // nanoseconds this thread has spent in record_visit'ed calls, so parse
+    // timers can subtract the callbacks that ran inside the parser
+    static uint64_t thread_visit_ns();
+
+    // Stop sampling and write the JSON report.
+    void write_report(const std::string& path, double wall_seconds);
+
+private:
+    struct Level {
+        uint64_t expanded = 0;
+        uint64_t neighbors = 0;
+        uint64_t discovered = 0;
+    };
+    struct Sample {
+        double t;
+        uint64_t requests;
+        uint64_t nodes;
+        long in_flight;
+        long queued;
+    };
+
+    void sampler(double progress);
+    void take_sample(double t);
+    void stop();
+
+    LatencyHistogram request_latency;
+    LatencyHistogram parse;
+    LatencyHistogram visit;
+    LatencyHistogram lock_wait;
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<long> in_flight{0};
+
+    std::mutex m; // levels, samples, queue_depth
+    std::vector<Level> levels;
+    std::vector<Sample> samples;
+    std::function<size_t()> queue_depth;
+
+    uint64_t started;
+    bool stopping = false;
+    std::condition_variable wake;
+    std::thread sampling;
+};
+
+// Times its scope into telemetry->*Record; no clock reads when telemetry is null.
+template <void (Telemetry::*Record)(uint64_t)>
+class TelemetryTimer {
+public:
+    explicit TelemetryTimer(Telemetry* telemetry)
+        : telemetry(telemetry), start(telemetry ? Telemetry::now_ns() : 0) {}
+    ~TelemetryTimer() {
+        if (telemetry)
+            (telemetry->*Record)(Telemetry::now_ns() - start);
+    }
+
+private:
+    Telemetry* telemetry;
+    uint64_t start;
+};
+
+using VisitTimer = TelemetryTimer<&Telemetry::record_visit>;
+
+// Times a parse, minus the visit callbacks it made on this thread.
+class ParseTimer {
+public:
+    explicit ParseTimer(Telemetry* telemetry)
+        : telemetry(telemetry),
+          start(telemetry ? Telemetry::now_ns() : 0),
+          visits(telemetry ? Telemetry::thread_visit_ns() : 0) {}
+    ~ParseTimer() {
+        if (telemetry)
+            telemetry->record_parse(Telemetry::now_ns() - start - (Telemetry::thread_visit_ns() - visits));
+    }
+
+private:
+    Telemetry* telemetry;
+    uint64_t start;
+    uint64_t visits;
+};
+
+// Lock m, charging the wait to the lock-wait histogram when telemetry is on.
+inline std::unique_lock<std::mutex> timed_lock(std::mutex& m, Telemetry* telemetry) {
+    if (!telemetry)
+        return std::unique_lock<std::mutex>(m);
+    uint64_t start = Telemetry::now_ns();
+    std::unique_lock<std::mutex> lock(m);
+    telemetry->record_lock_wait(Telemetry::now_ns() - start);
+    return lock;
+}
+
+// --telemetry <file> --progress <seconds>, shared by the crawlers' CLIs
+struct TelemetryOptions {
+    std::string path;
+    double progress = 0;
+
+    static const char* usage() { return "[--telemetry <report.json>] [--progress <seconds>]"; }
+
+    // Consume argv[i] (and its value) if it is a telemetry option. Throws
+    // invalid_argument on a missing or malformed value.
+    bool parse(int argc, char* argv[], int& i);
+
+    // null (instrumentation off) unless one of the options was given
+    std::unique_ptr<Telemetry> open() const;
+
+    // write the report if --telemetry was given
+    void finish(Telemetry* telemetry, double wall_seconds) const;
+};
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Run every crawler engine across depths and thread counts against a local
+stand_in_server (or any --service) and report wall time, nodes/s and
+requests/s as CSV and/or JSON.
+
+Build the crawlers first (make in graphcrawler, graphcrawlerparallel and
+queueblockgraphcrawler). By default a stand_in_server is started on a free
+port with the synthetic graph; --graph/--latency/--jitter are passed to it,
+so a crawl recorded with --cache can be replayed with realistic timing:
+
+  tools/crawl_bench.py --graph hollywood.cache --latency 40 --jitter 20 \\
+      --depths 2,3 --threads 1,2,4,8,16 --csv crawl.csv --json crawl.json
+
+Engines (--engines picks a subset):
+  sequential    graph_crawler, one thread
+  level_threads graphcrawlerparallel level_client, its fixed 8 threads
+  level_multi   graphcrawlerparallel level_client --multi <threads>
+                (threads = requests in flight, one event loop)
+  queue         queueblockgraphcrawler level_client with <threads> workers
+Others can be added with --engine 'name=command {start} {depth} {threads}'
+(paths relative to the repository root); {threads} in the command makes it
+run once per thread count.
+
+Requests are counted by the server's /stats endpoint, so requests/s is empty
+when --service points at a server without one.
+"""
+
+import argparse
+import csv
+import json
+import os
+import shlex
+import socket
+import subprocess
+import sys
+import time
+import urllib.request
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+SERVER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "stand_in_server.py")
+
+ENGINES = {
+    "sequential": "graphcrawler/graph_crawler {start} {depth}",
+    "level_threads": "graphcrawlerparallel/level_client {start} {depth}",
+    "level_multi": "graphcrawlerparallel/level_client {start} {depth} --multi {threads}",
+    "queue": "queueblockgraphcrawler/level_client {start} {depth} {threads}",
+}
+
+FIELDS = ["engine", "depth", "threads", "run", "seconds", "nodes", "requests", "nodes_per_s",
+          "requests_per_s", "exit_code"]
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def fetch_stats(stats_url):
+    if not stats_url:
+        return None
+    try:
+        with urllib.request.urlopen(stats_url, timeout=5) as r:
+            return sum(json.load(r).values())
+    except (OSError, ValueError):
+        return None
+
+
+def count_nodes(output):
+    # level_client prints "- name" per node, graph_crawler "name (depth d)"
+    return sum(1 for line in output.splitlines()
+               if line.startswith("- ") or (line.endswith(")") and " (depth " in line))
+
+
+def run_one(command, service, stats_url, timeout):
+    argv = command + ["--service", service]
+    before = fetch_stats(stats_url)
+    start = time.monotonic()
+    try:
+        proc = subprocess.run(argv, cwd=ROOT, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                              text=True, timeout=timeout)
+        output, code = proc.stdout, proc.returncode
+    except subprocess.TimeoutExpired as e:
+        output, code = e.stdout or "", "timeout"
+        if isinstance(output, bytes):
+            output = output.decode(errors="replace")
+    seconds = time.monotonic() - start
+    after = fetch_stats(stats_url)
+    nodes = count_nodes(output)
+    requests = after - before if before is not None and after is not None else None
+    return {
+        "seconds": round(seconds, 4),
+        "nodes": nodes,
+        "requests": requests,
+        "nodes_per_s": round(nodes / seconds, 1) if seconds > 0 else None,
+        "requests_per_s": round(requests / seconds, 1) if requests is not None and seconds > 0 else None,
+        "exit_code": code,
+    }
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("--service", help="crawl this service instead of starting a stand_in_server")
+    p.add_argument("--graph", help="recorded graph for the stand_in_server (cache file or JSON)")
+    p.add_argument("--latency", type=float, default=20, help="stand_in_server latency, ms (default 20)")
+    p.add_argument("--jitter", type=float, default=0, help="stand_in_server mean extra latency, ms")
+    p.add_argument("--start", default="Tom Hanks")
+    p.add_argument("--depths", default="2,3")
+    p.add_argument("--threads", default="1,2,4,8,16")
+    p.add_argument("--engines", default=",".join(ENGINES))
+    p.add_argument("--engine", action="append", default=[], metavar="NAME=COMMAND",
+                   help="extra engine, e.g. 'mine=mydir/crawler {start} {depth} {threads}'")
+    p.add_argument("--repeat", type=int, default=1)
+    p.add_argument("--timeout", type=float, default=600, help="per run, seconds")
+    p.add_argument("--csv", help="write rows here ('-' for stdout, the default without --json)")
+    p.add_argument("--json", help="write rows plus the setup here")
+    args = p.parse_args()
+
+    engines = {name: ENGINES[name] for name in args.engines.split(",") if name}
+    for spec in args.engine:
+        name, _, command = spec.partition("=")
+        engines[name] = command
+    depths = [int(d) for d in args.depths.split(",")]
+    thread_counts = [int(t) for t in args.threads.split(",")]
+
+    server = None
+    if args.service:
+        service = args.service
+    else:
+        port = free_port()
+        cmd = [sys.executable, SERVER, "--port", str(port), "--latency", str(args.latency),
+               "--jitter", str(args.jitter)]
+        if args.graph:
+            cmd += ["--graph", args.graph]
+        server = subprocess.Popen(cmd, stderr=subprocess.DEVNULL)
+        service = f"http://127.0.0.1:{port}/neighbors/"
+    stats_url = service.rsplit("/neighbors/", 1)[0] + "/stats" if "/neighbors/" in service else None
+
+    rows = []
+    try:
+        if server:
+            for _ in range(50):
+                if fetch_stats(stats_url) is not None:
+                    break
+                time.sleep(0.1)
+        for name, template in engines.items():
+            binary = shlex.split(template)[0]
+            if not os.path.exists(os.path.join(ROOT, binary)):
+                print(f"skipping {name}: {binary} is not built", file=sys.stderr)
+                continue
+            scales = "{threads}" in template
+            for depth in depths:
+                for threads in thread_counts if scales else [None]:
+                    command = [part.format(start=args.start, depth=depth, threads=threads)
+                               for part in shlex.split(template)]
+                    for run in range(args.repeat):
+                        row = {"engine": name, "depth": depth, "threads": threads, "run": run}
+                        row.update(run_one(command, service, stats_url, args.timeout))
+                        rows.append(row)
+                        print(f"{name} depth={depth} threads={threads} run={run}: {row['seconds']}s "
+                              f"{row['nodes']} nodes {row['requests']} requests", file=sys.stderr)
+    finally:
+        if server:
+            server.terminate()
+            server.wait()
+
+    if args.csv or not args.json:
+        out = sys.stdout if not args.csv or args.csv == "-" else open(args.csv, "w", newline="")
+        writer = csv.DictWriter(out, fieldnames=FIELDS)
+        writer.writeheader()
+        writer.writerows(rows)
+        if out is not sys.stdout:
+            out.close()
+    if args.json:
+        setup = {"service": args.service, "graph": args.graph, "latency_ms": args.latency,
+                 "jitter_ms": args.jitter, "start": args.start, "engines": engines}
+        with open(args.json, "w") as f:
+            json.dump({"setup": setup, "runs": rows}, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
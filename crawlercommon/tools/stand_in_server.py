@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Local stand-in for the hollywood neighbors service, for reproducible benchmarks
+and for making the crawlers' error handling misbehave on purpose.
+
+Serves GET /neighbors/<node> from either
+  --graph FILE        a recorded graph: a neighbor cache file written by any
+                      crawler's --cache (crawl the live service once, replay it
+                      forever), or a JSON object {"node": ["neighbor", ...]}
+  (default)           a seeded synthetic actor/movie graph with a "Tom Hanks" hub
+                      so the crawlers' usual start node works
+Unknown nodes get an empty neighbor list, as the live service does.
+
+Timing:
+  --latency MS        added to every response
+  --jitter MS         plus an exponentially distributed delay with this mean
+
+Injected failures:
+  --max-rps R         token bucket over all clients; excess gets 429 + Retry-After
+  --max-concurrent C  more than C requests in flight gets 503 + Retry-After
+  --error-rate P      fraction of requests answered with a plain 500
+  --drop-rate P       fraction of connections closed without any response
+
+Point a crawler at it with --service http://127.0.0.1:<port>/neighbors/
+GET /stats returns the response counts so far as JSON; they are also printed
+to stderr on exit (Ctrl-C / SIGTERM).
+"""
+
+import argparse
+import json
+import random
+import signal
+import struct
+import sys
+import threading
+import time
+import urllib.parse
+from collections import Counter
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def build_graph(actors, movies, seed):
+    rng = random.Random(seed)
+    actor_names = [f"Actor {i}" for i in range(actors)]
+    adj = {}
+    for i in range(movies):
+        movie = f"Movie {i}"
+        for actor in rng.sample(actor_names, rng.randint(2, 25)):
+            adj.setdefault(movie, []).append(actor)
+            adj.setdefault(actor, []).append(movie)
+    hub = [f"Movie {i}" for i in range(min(30, movies))]
+    adj["Tom Hanks"] = hub
+    for movie in hub:
+        adj[movie].append("Tom Hanks")
+    return adj
+
+
+def load_cache_file(data):
+    """Adjacency from a NeighborCache file (see neighbor_cache.h); the last
+    record for a key wins and tombstones remove it."""
+    adj = {}
+    pos = 16
+    while pos + 16 <= len(data):
+        key_len, count, _fetched_at = struct.unpack_from("<IIq", data, pos)
+        pos += 16
+        key = data[pos:pos + key_len].decode()
+        pos += key_len
+        if count == 0xFFFFFFFF:
+            adj.pop(key, None)
+            continue
+        neighbors = []
+        for _ in range(count):
+            (n,) = struct.unpack_from("<I", data, pos)
+            neighbors.append(data[pos + 4:pos + 4 + n].decode())
+            pos += 4 + n
+        adj[key] = neighbors
+    return adj
+
+
+def load_graph(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data.startswith(b"NBRCACHE"):
+        return load_cache_file(data)
+    return json.loads(data)
+
+
+class TokenBucket:
+    def __init__(self, rate):
+        self.rate = rate
+        self.capacity = max(1.0, rate / 10)
+        self.tokens = self.capacity
+        self.last = time.monotonic()
+        self.lock = threading.Lock()
+
+    def take(self):
+        with self.lock:
+            now = time.monotonic()
+            self.tokens = min(self.capacity, self.tokens + (now - self.last) * self.rate)
+            self.last = now
+            if self.tokens < 1:
+                return False
+            self.tokens -= 1
+            return True
+
+
+def make_handler(args, adj, stats):
+    bucket = TokenBucket(args.max_rps) if args.max_rps > 0 else None
+    in_flight = [0]
+    lock = threading.Lock()
+    rng = random.Random(args.seed + 1)
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def reply(self, status, body, retry_after=None, count=True):
+            data = body.encode()
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(data)))
+            if retry_after is not None:
+                self.send_header("Retry-After", str(retry_after))
+            self.end_headers()
+            self.wfile.write(data)
+            if count:
+                with lock:
+                    stats[status] += 1
+
+        def do_GET(self):
+            if self.path == "/stats":
+                with lock:
+                    body = json.dumps({str(k): v for k, v in stats.items()})
+                self.reply(200, body, count=False)
+                return
+            if not self.path.startswith("/neighbors/"):
+                self.reply(404, '{"error": "not found"}')
+                return
+            node = urllib.parse.unquote(self.path[len("/neighbors/"):])
+
+            with lock:
+                roll = rng.random()
+                delay = args.latency + (rng.expovariate(1.0 / args.jitter) if args.jitter > 0 else 0)
+                in_flight[0] += 1
+                crowded = args.max_concurrent > 0 and in_flight[0] > args.max_concurrent
+            try:
+                if roll < args.drop_rate:
+                    with lock:
+                        stats["dropped"] += 1
+                    self.close_connection = True
+                    self.connection.shutdown(2)
+                    return
+                if bucket and not bucket.take():
+                    self.reply(429, '{"error": "too many requests"}', args.retry_after)
+                    return
+                if crowded:
+                    self.reply(503, '{"error": "overloaded"}', args.retry_after)
+                    return
+                if roll < args.drop_rate + args.error_rate:
+                    self.reply(500, '{"error": "internal"}')
+                    return
+                if delay > 0:
+                    time.sleep(delay / 1000.0)
+                self.reply(200, json.dumps({"node": node, "neighbors": adj.get(node, [])}))
+            finally:
+                with lock:
+                    in_flight[0] -= 1
+
+        def log_message(self, *a):
+            pass
+
+    return Handler
+
+
+class Server(ThreadingHTTPServer):
+    request_queue_size = 1024
+    daemon_threads = True
+
+    def handle_error(self, request, client_address):
+        # dropped connections are deliberate
+        if not isinstance(sys.exc_info()[1], OSError):
+            super().handle_error(request, client_address)
+
+
+def stop(*_):
+    raise KeyboardInterrupt
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("--port", type=int, default=8765)
+    p.add_argument("--graph", help="recorded graph: neighbor cache file or JSON adjacency")
+    p.add_argument("--actors", type=int, default=3000)
+    p.add_argument("--movies", type=int, default=1500)
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("--latency", type=float, default=0, help="milliseconds added to every response")
+    p.add_argument("--jitter", type=float, default=0, help="mean of an extra exponential delay, milliseconds")
+    p.add_argument("--max-rps", type=float, default=0)
+    p.add_argument("--max-concurrent", type=int, default=0)
+    p.add_argument("--retry-after", type=int, default=1, help="seconds sent with 429/503")
+    p.add_argument("--error-rate", type=float, default=0)
+    p.add_argument("--drop-rate", type=float, default=0)
+    args = p.parse_args()
+
+    adj = load_graph(args.graph) if args.graph else build_graph(args.actors, args.movies, args.seed)
+    stats = Counter()
+    server = Server(("127.0.0.1", args.port), make_handler(args, adj, stats))
+    signal.signal(signal.SIGTERM, stop)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("stand_in_server: " + ", ".join(f"{k}={v}" for k, v in sorted(stats.items(), key=str)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+#!/bin/bash
+# Crawl a stand_in_server twice, once well-behaved and once throttling and
+# failing, with every level_client engine, and check that the throttled
+# crawls find exactly the same levels (no node lost to a 429 or an error).
+# Then crawl a larger graph with jittered latency at depth 4 and check that
+# the queue crawlers, which have no barrier between levels, still put every
+# node at its BFS depth, and that ../crawler/crawl's engines agree.
+#
+# usage: tools/throttle_test.sh [depth] [max_rps]
+# Build ../graphcrawlerparallel, ../queueblockgraphcrawler and ../crawler first.
+
+cd "$(dirname "$0")/.." || exit 1
+DEPTH=${1:-3}
+MAX_RPS=${2:-400}
+CLEAN_PORT=8791
+THROTTLED_PORT=8792
+JITTER_PORT=8793
+PARALLEL=../graphcrawlerparallel/level_client
+QUEUE=../queueblockgraphcrawler/level_client
+CRAWL=../crawler/crawl
+TMP=$(mktemp -d)
+PIDS=()
+
+cleanup() {
+    kill "${PIDS[@]}" 2>/dev/null
+    wait "${PIDS[@]}" 2>/dev/null
+    rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+for bin in $PARALLEL $QUEUE $CRAWL; do
+    if [ ! -x $bin ]; then
+        echo "missing $bin, build it first" >&2
+        exit 1
+    fi
+done
+
+python3 tools/stand_in_server.py --port $CLEAN_PORT 2> "$TMP/clean_server.log" &
+PIDS+=($!)
+python3 tools/stand_in_server.py --port $THROTTLED_PORT --latency 5 --max-rps "$MAX_RPS" \
+    --max-concurrent 24 --error-rate 0.02 --drop-rate 0.01 2> "$TMP/throttled_server.log" &
+PIDS+=($!)
+python3 tools/stand_in_server.py --port $JITTER_PORT --actors 20000 --movies 6000 --jitter 10 \
+    2> "$TMP/jitter_server.log" &
+PIDS+=($!)
+sleep 1
+
+# levels without the timing line, order within a level ignored
+crawl() {
+    local port=$1 out=$2
+    shift 2
+    "$@" --service "http://127.0.0.1:$port/neighbors/" 2> "$out.err" | grep -v "^Time" | sort > "$out"
+}
+
+crawl $CLEAN_PORT "$TMP/expected" $PARALLEL "Tom Hanks" "$DEPTH"
+echo "reference crawl: $(grep -c '^- ' "$TMP/expected") nodes"
+crawl $JITTER_PORT "$TMP/expected_jitter" $PARALLEL "Tom Hanks" 4
+echo "jittered reference crawl: $(grep -c '^- ' "$TMP/expected_jitter") nodes"
+
+status=0
+# run <name> <port> <expected> <command...>
+run() {
+    local name=$1 port=$2 expected=$3
+    shift 3
+    local start=$(date +%s%N)
+    crawl $port "$TMP/$name" "$@"
+    local ms=$(( ($(date +%s%N) - start) / 1000000 ))
+    if cmp -s "$expected" "$TMP/$name"; then
+        echo "PASS $name (${ms} ms)"
+    else
+        echo "FAIL $name (${ms} ms): levels differ from the reference crawl"
+        status=1
+    fi
+    sed 's/^/    /' "$TMP/$name.err"
+}
+
+run threads $THROTTLED_PORT "$TMP/expected" $PARALLEL "Tom Hanks" "$DEPTH"
+run multi $THROTTLED_PORT "$TMP/expected" $PARALLEL "Tom Hanks" "$DEPTH" --multi 64
+run multi_2loops $THROTTLED_PORT "$TMP/expected" $PARALLEL "Tom Hanks" "$DEPTH" --multi 64 --loops 2
+run queue $THROTTLED_PORT "$TMP/expected" $QUEUE "Tom Hanks" "$DEPTH" 16
+run queue_jitter_4 $JITTER_PORT "$TMP/expected_jitter" $QUEUE "Tom Hanks" 4 4
+run queue_jitter_16 $JITTER_PORT "$TMP/expected_jitter" $QUEUE "Tom Hanks" 4 16
+run crawl_level_jitter $JITTER_PORT "$TMP/expected_jitter" $CRAWL "Tom Hanks" 4 --engine level --threads 16
+run crawl_queue_jitter $JITTER_PORT "$TMP/expected_jitter" $CRAWL "Tom Hanks" 4 --engine queue --threads 16
+
+kill "${PIDS[@]}" 2>/dev/null
+wait "${PIDS[@]}" 2>/dev/null
+PIDS=()
+sed 's/^/    /' "$TMP/throttled_server.log"
+exit $status
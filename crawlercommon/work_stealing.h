@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers with one task deque each, work stealing, and
+// termination detection that needs no polling.
+//
+// A worker pushes at the back of its own deque and takes from the front, so
+// each deque runs oldest first and a crawl stays close to BFS order; an idle
+// worker steals from the front of someone else's (the oldest task there too).
+// `outstanding` counts tasks pushed but not yet finished, so it reaches zero
+// exactly when no task is queued or running and none can appear any more.
+// Workers with nothing to steal park on a condition variable and are woken by
+// the next push or by termination.
+template <class Task>
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int workers) : deques(std::max(1, workers)) {}
+
+    int size() const { return deques.size(); }
+
+    // Seed the pool with `initial`, then call process(worker, task) for every
+    // task until none are outstanding. process may push() more tasks. Blocks
+    // the caller until all workers exit; the first exception thrown by
+    // process stops the pool and is rethrown here.
+    template <class F>
+    void run(const std::vector<Task>& initial, F process) {
+        for (size_t i = 0; i < initial.size(); ++i)
+            push(i % deques.size(), initial[i]);
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < size(); ++w)
+            threads.emplace_back([this, w, &process] { worker(w, process); });
+        for (auto& t : threads)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Queue a task on `worker`'s deque; call from process on that worker.
+    void push(int worker, const Task& task) {
+        outstanding.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(deques[worker].m);
+            deques[worker].tasks.push_back(task);
+        }
+        queued.fetch_add(1);
+        if (sleepers.load() > 0) {
+            std::lock_guard<std::mutex> lock(park_m);
+            park_cv.notify_one();
+        }
+    }
+
+    // tasks currently sitting in deques (not counting running ones)
+    size_t queued_tasks() const { return queued.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Deque {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    bool pop_own(int w, Task& task) {
+        std::lock_guard<std::mutex> lock(deques[w].m);
+        if (deques[w].tasks.empty())
+            return false;
+        task = deques[w].tasks.front();
+        deques[w].tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int w, Task& task) {
+        int n = size();
+        for (int k = 1; k < n; ++k) {
+            Deque& victim = deques[(w + k) % n];
+            std::lock_guard<std::mutex> lock(victim.m);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Get the next task for w, parking while there is none. Returns false once
+    // the pool has terminated or been stopped.
+    bool next(int w, Task& task) {
+        while (true) {
+            if (stopped.load())
+                return false;
+            if (pop_own(w, task) || steal(w, task)) {
+                queued.fetch_sub(1);
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(park_m);
+            sleepers.fetch_add(1);
+            // pushers bump `queued` before reading `sleepers`, we bump
+            // `sleepers` before reading `queued`: one of us sees the other
+            while (queued.load() == 0 && outstanding.load() > 0 && !stopped.load())
+                park_cv.wait(lock);
+            sleepers.fetch_sub(1);
+            if (outstanding.load() == 0)
+                return false;
+        }
+    }
+
+    template <class F>
+    void worker(int w, F& process) {
+        Task task;
+        while (next(w, task)) {
+            try {
+                process(w, task);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(park_m);
+                if (!error)
+                    error = std::current_exception();
+                stopped.store(true);
+                park_cv.notify_all();
+                return;
+            }
+            if (outstanding.fetch_sub(1) == 1) {
+                // last task done: wake everyone so they can exit
+                std::lock_guard<std::mutex> lock(park_m);
+                park_cv.notify_all();
+            }
+        }
+    }
+
+    std::vector<Deque> deques;
+    std::atomic<size_t> outstanding{0};
+    std::atomic<size_t> queued{0};
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stopped{false};
+    std::mutex park_m;
+    std::condition_variable park_cv;
+    std::exception_ptr error;
+};
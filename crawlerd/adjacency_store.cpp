@@ -0,0 +1,77 @@
+#include "adjacency_store.h"
+
+#include <iostream>
+
+using namespace std;
+
+AdjacencyStore::AdjacencyStore(NeighborSource& source, StringInterner& names, int workers) : names(names) {
+    for (int w = 0; w < std::max(1, workers); ++w)
+        sessions.push_back(source.session());
+    for (auto& session : sessions)
+        threads.emplace_back([this, s = session.get()] { worker(*s); });
+}
+
+AdjacencyStore::~AdjacencyStore() {
+    {
+        lock_guard<mutex> lock(m);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+shared_future<AdjacencyStore::List> AdjacencyStore::request(NodeId id, Source& how) {
+    shared_ptr<promise<List>> result;
+    auto [slot, inserted] = slots.insert_if_absent(id, [&] {
+        result = make_shared<promise<List>>();
+        return result->get_future().share();
+    });
+    if (!inserted) {
+        how = slot.wait_for(chrono::seconds(0)) == future_status::ready ? Source::Memory : Source::InFlight;
+        return slot;
+    }
+    how = Source::Fetched;
+    {
+        lock_guard<mutex> lock(m);
+        jobs.push_back({id, std::move(result)});
+    }
+    wake.notify_one();
+    return slot;
+}
+
+void AdjacencyStore::forget(NodeId id) {
+    slots.with_shard(id, [&](ShardedMap<NodeId, shared_future<List>>::Map& map) { return map.erase(id); });
+}
+
+void AdjacencyStore::worker(NeighborSource::Session& session) {
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(m);
+            wake.wait(lock, [&] { return quit || !jobs.empty(); });
+            if (quit)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const string& node = names.name(job.id);
+        auto list = make_shared<vector<NodeId>>();
+        try {
+            bool ok = session.neighbors(node, [&](string_view neighbor) { list->push_back(names.intern(neighbor)); });
+            fetched.fetch_add(1, memory_order_relaxed);
+            if (!ok) {
+                // answer the queries waiting on it, but don't keep the gap
+                failed.fetch_add(1, memory_order_relaxed);
+                forget(job.id);
+            }
+            job.result->set_value(std::move(list));
+        } catch (const exception& e) {
+            cerr << "Error while fetching neighbors of: " << node << ": " << e.what() << endl;
+            failed.fetch_add(1, memory_order_relaxed);
+            forget(job.id);
+            job.result->set_exception(current_exception());
+        }
+    }
+}
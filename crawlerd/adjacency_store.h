@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "crawler.h"
+#include "sharded_map.h"
+
+// Warm in-memory adjacency for the daemon: the neighbor ids of every node any
+// query has expanded, kept for the life of the process. A miss is fetched once
+// by a shared pool of fetch workers, one NeighborSource session each; queries
+// that ask for a node already in flight wait for that fetch instead of
+// starting another.
+class AdjacencyStore {
+public:
+    using List = std::shared_ptr<const std::vector<NodeId>>;
+
+    // how a request was served
+    enum class Source { Memory, InFlight, Fetched };
+
+    AdjacencyStore(NeighborSource& source, StringInterner& names, int workers);
+    ~AdjacencyStore();
+
+    AdjacencyStore(const AdjacencyStore&) = delete;
+    AdjacencyStore& operator=(const AdjacencyStore&) = delete;
+
+    // Neighbors of id, queueing a fetch if no one has asked for them yet.
+    // get() on the result rethrows a failed fetch's exception.
+    std::shared_future<List> request(NodeId id, Source& how);
+
+    size_t nodes() const { return slots.size(); }
+    uint64_t fetches() const { return fetched.load(std::memory_order_relaxed); }
+    uint64_t failures() const { return failed.load(std::memory_order_relaxed); }
+
+private:
+    struct Job {
+        NodeId id;
+        std::shared_ptr<std::promise<List>> result;
+    };
+
+    void worker(NeighborSource::Session& session);
+    // drop a failed node so the next request fetches it again
+    void forget(NodeId id);
+
+    StringInterner& names;
+    ShardedMap<NodeId, std::shared_future<List>> slots;
+
+    std::vector<std::unique_ptr<NeighborSource::Session>> sessions; // one per worker
+    std::mutex m;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    bool quit = false;
+    std::vector<std::thread> threads;
+
+    std::atomic<uint64_t> fetched{0};
+    std::atomic<uint64_t> failed{0};
+};
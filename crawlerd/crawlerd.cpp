@@ -0,0 +1,323 @@
+#include <curl/curl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "adjacency_store.h"
+#include "crawler.h"
+
+using namespace std;
+
+// Resident crawler: answers k-hop, path and degree queries over a unix socket
+// from the warm in-memory adjacency in AdjacencyStore, so repeated lookups pay
+// neither process startup nor a cold cache. One thread per connection runs its
+// queries; every fetch goes through the store's shared worker pool.
+//
+// Protocol: one request per line, fields separated by tabs
+//   khop\t<node>\t<k>       level_client's listing: "- <name>" lines, level size
+//   path\t<from>\t<to>      "- <name>" per node of a shortest path, "Hops: n"
+//   degree\t<node>          number of neighbors
+//   stats                   store size and fetch counts
+// Each response ends with a "# hits=.. shared=.. fetched=.. time=..ms" line
+// (nodes served from memory, waited for on another query's fetch, fetched for
+// this query) and a blank line. Errors are a single "error: <message>" line.
+
+const NodeId NO_NODE = UINT32_MAX;
+
+// What one query did
+struct QueryStats {
+    uint64_t hits = 0;
+    uint64_t shared = 0;
+    uint64_t fetched = 0;
+};
+
+class QueryRunner {
+public:
+    QueryRunner(AdjacencyStore& store, StringInterner& names) : store(store), names(names) {}
+
+    // Neighbor lists of every node in frontier: all misses are queued before
+    // waiting on any, so they are fetched in parallel.
+    vector<AdjacencyStore::List> expand(const vector<NodeId>& frontier) {
+        vector<shared_future<AdjacencyStore::List>> pending;
+        pending.reserve(frontier.size());
+        for (NodeId u : frontier) {
+            AdjacencyStore::Source how;
+            pending.push_back(store.request(u, how));
+            if (how == AdjacencyStore::Source::Memory)
+                stats.hits++;
+            else if (how == AdjacencyStore::Source::InFlight)
+                stats.shared++;
+            else
+                stats.fetched++;
+        }
+        vector<AdjacencyStore::List> lists;
+        lists.reserve(pending.size());
+        for (auto& f : pending)
+            lists.push_back(f.get());
+        return lists;
+    }
+
+    void khop(const string& start, int k, ostream& out) {
+        vector<bool> visited;
+        auto visit = [&](NodeId id) {
+            if (visited.size() <= id)
+                visited.resize(std::max<size_t>(names.size(), id + 1));
+            if (visited[id])
+                return false;
+            visited[id] = true;
+            return true;
+        };
+        vector<NodeId> frontier = {names.intern(start)};
+        visit(frontier[0]);
+        for (int d = 0;; ++d) {
+            for (NodeId id : frontier)
+                out << "- " << names.name(id) << "\n";
+            out << frontier.size() << "\n";
+            if (d == k)
+                break;
+            vector<AdjacencyStore::List> lists = expand(frontier);
+            frontier.clear();
+            for (const auto& list : lists)
+                for (NodeId v : *list)
+                    if (visit(v))
+                        frontier.push_back(v);
+            // the whole component is listed; like level_client, no empty levels
+            if (frontier.empty())
+                break;
+        }
+    }
+
+    // Bidirectional BFS, as level_client's path mode: each step expands the
+    // smaller frontier one level and stops at the first node both sides reached.
+    void path(const string& from, const string& to, ostream& out) {
+        NodeId ends[2] = {names.intern(from), names.intern(to)};
+        struct Side {
+            unordered_map<NodeId, NodeId> parent;
+            vector<NodeId> frontier;
+        } sides[2];
+        for (int k = 0; k < 2; ++k) {
+            sides[k].parent[ends[k]] = NO_NODE;
+            sides[k].frontier.push_back(ends[k]);
+        }
+
+        vector<NodeId> path;
+        if (ends[0] == ends[1])
+            path.push_back(ends[0]);
+        while (path.empty() && !sides[0].frontier.empty() && !sides[1].frontier.empty()) {
+            int k = sides[0].frontier.size() <= sides[1].frontier.size() ? 0 : 1;
+            Side& near = sides[k];
+            Side& far = sides[1 - k];
+            vector<AdjacencyStore::List> lists = expand(near.frontier);
+            vector<NodeId> next;
+            for (size_t i = 0; i < lists.size() && path.empty(); ++i) {
+                NodeId u = near.frontier[i];
+                for (NodeId v : *lists[i]) {
+                    if (!near.parent.emplace(v, u).second)
+                        continue;
+                    next.push_back(v);
+                    if (far.parent.count(v)) {
+                        // v back to the near root, then on to the far root
+                        for (NodeId x = v; x != NO_NODE; x = near.parent[x])
+                            path.push_back(x);
+                        std::reverse(path.begin(), path.end());
+                        for (NodeId x = far.parent[v]; x != NO_NODE; x = far.parent[x])
+                            path.push_back(x);
+                        if (k == 1)
+                            std::reverse(path.begin(), path.end());
+                        break;
+                    }
+                }
+            }
+            near.frontier = std::move(next);
+        }
+
+        if (path.empty()) {
+            out << "No path from " << from << " to " << to << "\n";
+            return;
+        }
+        for (NodeId id : path)
+            out << "- " << names.name(id) << "\n";
+        out << "Hops: " << path.size() - 1 << "\n";
+    }
+
+    void degree(const string& node, ostream& out) {
+        out << expand({names.intern(node)})[0]->size() << "\n";
+    }
+
+    QueryStats stats;
+
+private:
+    AdjacencyStore& store;
+    StringInterner& names;
+};
+
+// Run one request line; the response goes to out.
+void handle(const string& line, AdjacencyStore& store, StringInterner& names, ostream& out) {
+    vector<string> fields;
+    stringstream in(line);
+    for (string field; getline(in, field, '\t');)
+        fields.push_back(field);
+    const string command = fields.empty() ? "" : fields[0];
+
+    const auto start = chrono::steady_clock::now();
+    QueryRunner runner(store, names);
+    ostringstream body;
+    try {
+        if (command == "khop" && fields.size() == 3) {
+            int k = stoi(fields[2]);
+            if (k < 0) {
+                out << "error: k must be >= 0\n\n";
+                return;
+            }
+            runner.khop(fields[1], k, body);
+        } else if (command == "path" && fields.size() == 3) {
+            runner.path(fields[1], fields[2], body);
+        } else if (command == "degree" && fields.size() == 2) {
+            runner.degree(fields[1], body);
+        } else if (command == "stats" && fields.size() == 1) {
+            body << "Nodes: " << store.nodes() << "\nFetches: " << store.fetches() << "\nFailed: " << store.failures()
+                 << "\n";
+        } else {
+            out << "error: expected khop\\t<node>\\t<k>, path\\t<from>\\t<to>, degree\\t<node> or stats\n\n";
+            return;
+        }
+    } catch (const exception& e) {
+        out << "error: " << e.what() << "\n\n";
+        return;
+    }
+    const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    out << body.str() << "# hits=" << runner.stats.hits << " shared=" << runner.stats.shared
+        << " fetched=" << runner.stats.fetched << " time=" << elapsed.count() << "ms\n\n";
+}
+
+bool write_all(int fd, const string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+void serve(int fd, AdjacencyStore& store, StringInterner& names) {
+    string buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = recv(fd, chunk, sizeof chunk, 0)) > 0) {
+        buffer.append(chunk, n);
+        size_t end;
+        while ((end = buffer.find('\n')) != string::npos) {
+            string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            ostringstream response;
+            handle(line, store, names, response);
+            if (!write_all(fd, response.str())) {
+                close(fd);
+                return;
+            }
+        }
+    }
+    close(fd);
+}
+
+int listen_fd = -1;
+
+void stop_listening(int) {
+    // async-signal-safe: accept() fails and main shuts down
+    shutdown(listen_fd, SHUT_RDWR);
+}
+
+void usage(const char* prog) {
+    cerr << "Usage: " << prog << " [--socket <path>] [--workers <n>]\n"
+         << "       " << CacheOptions::usage() << "\n"
+         << "       " << FetchOptions::usage() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    string socket_path = "/tmp/crawlerd.sock";
+    int workers = 16;
+    CacheOptions cache_options;
+    FetchOptions fetch_options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (cache_options.parse(argc, argv, i) || fetch_options.parse(argc, argv, i))
+                continue;
+            string opt = argv[i];
+            if (opt == "--socket" && i + 1 < argc) {
+                socket_path = argv[++i];
+            } else if (opt == "--workers" && i + 1 < argc) {
+                workers = stoi(argv[++i]);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: Option values must be numbers.\n";
+        return 1;
+    }
+
+    unique_ptr<NeighborCache> cache;
+    try {
+        cache = cache_options.open();
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof addr.sun_path) {
+        cerr << "Error: socket path too long: " << socket_path << "\n";
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 ||
+        listen(listen_fd, 64) < 0) {
+        cerr << "Error: cannot listen on " << socket_path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    signal(SIGINT, stop_listening);
+    signal(SIGTERM, stop_listening);
+
+    {
+        FetchScope fetch(fetch_options, nullptr);
+        HttpSource http(fetch.context());
+        unique_ptr<NeighborSource> cached;
+        if (cache)
+            cached = make_unique<CachedSource>(*cache, &http);
+        StringInterner names;
+        AdjacencyStore store(cached ? *cached : http, names, workers);
+        cerr << "Listening on " << socket_path << " with " << workers << " fetch workers\n";
+
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0)
+            thread(serve, fd, ref(store), ref(names)).detach();
+
+        cerr << "Shutting down: " << store.nodes() << " nodes in memory, " << store.fetches() << " fetches\n";
+        fetch.rate().report(cerr);
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        // connection threads may still be using the store: leave without
+        // running its destructor, they die with the process
+        _exit(0);
+    }
+}
@@ -0,0 +1,78 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Command-line client for crawlerd: sends one request and prints the answer,
+// with the statistics line on stderr. Exits 1 on an error response.
+
+void usage(const char* prog) {
+    cerr << "Usage: " << prog << " [--socket <path>] khop <node_name> <k>\n"
+         << "       " << prog << " [--socket <path>] path <from> <to>\n"
+         << "       " << prog << " [--socket <path>] degree <node_name>\n"
+         << "       " << prog << " [--socket <path>] stats\n";
+}
+
+int main(int argc, char* argv[]) {
+    string socket_path = "/tmp/crawlerd.sock";
+    int first = 1;
+    if (argc > 2 && string(argv[1]) == "--socket") {
+        socket_path = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    string request = argv[first];
+    for (int i = first + 1; i < argc; ++i)
+        request += string("\t") + argv[i];
+    request += "\n";
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof addr.sun_path - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+        cerr << "Error: cannot connect to " << socket_path << ": " << strerror(errno) << " (is crawlerd running?)\n";
+        return 1;
+    }
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != ssize_t(request.size())) {
+        cerr << "Error: cannot send the request\n";
+        return 1;
+    }
+
+    // the response ends with a blank line
+    string response;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = recv(fd, chunk, sizeof chunk, 0)) > 0) {
+        size_t from = response.empty() ? 0 : response.size() - 1;
+        response.append(chunk, n);
+        if (response.find("\n\n", from) != string::npos)
+            break;
+    }
+    close(fd);
+
+    int status = 0;
+    size_t pos = 0, end;
+    while ((end = response.find('\n', pos)) != string::npos && end > pos) {
+        string line = response.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.compare(0, 2, "# ") == 0) {
+            cerr << line.substr(2) << "\n";
+        } else if (line.compare(0, 7, "error: ") == 0) {
+            cerr << "Error: " << line.substr(7) << "\n";
+            status = 1;
+        } else {
+            cout << line << "\n";
+        }
+    }
+    return status;
+}
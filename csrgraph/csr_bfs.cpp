@@ -0,0 +1,116 @@
+#include "csr_bfs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// steps over fewer items than this run on the calling thread: starting the
+// workers costs more than a few tens of thousands of nodes take to scan
+const size_t INLINE_WORK = 1 << 16;
+
+} // namespace
+
+DirectionOptimizingBfs::DirectionOptimizingBfs(const CsrGraph& graph, int threads)
+    : graph(graph),
+      threads(std::max(1, threads)),
+      depth_of(new atomic<uint32_t>[graph.node_count()]),
+      in_frontier((graph.node_count() + 63) / 64),
+      found(this->threads) {}
+
+void DirectionOptimizingBfs::parallel_for(size_t count, size_t chunk, const function<void(size_t, size_t, int)>& body) {
+    if (count <= INLINE_WORK || threads == 1) {
+        body(0, count, 0);
+        return;
+    }
+    atomic<size_t> cursor(0);
+    auto worker = [&](int w) {
+        size_t first;
+        while ((first = cursor.fetch_add(chunk, memory_order_relaxed)) < count)
+            body(first, std::min(count, first + chunk), w);
+    };
+    vector<thread> pool;
+    for (int w = 1; w < threads; ++w)
+        pool.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : pool)
+        t.join();
+}
+
+void DirectionOptimizingBfs::top_down(const vector<Node>& frontier, uint32_t depth) {
+    parallel_for(frontier.size(), 64, [&](size_t first, size_t last, int w) {
+        for (size_t i = first; i < last; ++i)
+            for (Node v : graph.neighbors(frontier[i])) {
+                uint32_t seen = depth_of[v].load(memory_order_relaxed);
+                if (seen == UNSEEN && depth_of[v].compare_exchange_strong(seen, depth, memory_order_relaxed))
+                    found[w].push_back(v);
+            }
+    });
+}
+
+void DirectionOptimizingBfs::bottom_up(const vector<Node>& frontier, uint32_t depth) {
+    fill(in_frontier.begin(), in_frontier.end(), 0);
+    for (Node u : frontier)
+        in_frontier[u >> 6] |= uint64_t(1) << (u & 63);
+    // each unvisited node is only written by the chunk that owns it, so no CAS
+    parallel_for(graph.node_count(), 1024, [&](size_t first, size_t last, int w) {
+        for (size_t u = first; u < last; ++u) {
+            if (depth_of[u].load(memory_order_relaxed) != UNSEEN)
+                continue;
+            for (Node v : graph.neighbors(u))
+                if ((in_frontier[v >> 6] >> (v & 63)) & 1) {
+                    depth_of[u].store(depth, memory_order_relaxed);
+                    found[w].push_back(u);
+                    break;
+                }
+        }
+    });
+}
+
+vector<vector<DirectionOptimizingBfs::Node>> DirectionOptimizingBfs::run(Node source, int max_depth) {
+    size_t n = graph.node_count();
+    for (size_t u = 0; u < n; ++u)
+        depth_of[u].store(UNSEEN, memory_order_relaxed);
+    last_steps.clear();
+
+    vector<vector<Node>> levels{{source}};
+    depth_of[source].store(0, memory_order_relaxed);
+    uint64_t unexplored = graph.edge_count() - graph.degree(source);
+    bool use_bottom_up = false;
+
+    for (uint32_t d = 0; max_depth < 0 || d < uint32_t(max_depth); ++d) {
+        const vector<Node>& frontier = levels[d];
+        if (frontier.empty())
+            break;
+        uint64_t frontier_edges = 0;
+        for (Node u : frontier)
+            frontier_edges += graph.degree(u);
+        if (!use_bottom_up && frontier_edges > unexplored / ALPHA)
+            use_bottom_up = true;
+        else if (use_bottom_up && frontier.size() < n / BETA && (d == 0 || frontier.size() < levels[d - 1].size()))
+            use_bottom_up = false;
+
+        auto started = chrono::steady_clock::now();
+        for (auto& f : found)
+            f.clear();
+        if (use_bottom_up)
+            bottom_up(frontier, d + 1);
+        else
+            top_down(frontier, d + 1);
+
+        vector<Node> next;
+        for (auto& f : found)
+            next.insert(next.end(), f.begin(), f.end());
+        for (Node u : next)
+            unexplored -= graph.degree(u);
+        last_steps.push_back({frontier.size(), use_bottom_up,
+                              chrono::duration<double>(chrono::steady_clock::now() - started).count()});
+        if (next.empty())
+            break;
+        levels.push_back(std::move(next));
+    }
+    return levels;
+}
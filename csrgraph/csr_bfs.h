@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "csr_graph.h"
+
+// Multithreaded direction-optimizing BFS over an undirected CsrGraph.
+//
+// Each level is expanded either top-down (every frontier node claims its
+// unvisited neighbors with a CAS) or bottom-up (every unvisited node looks for
+// any neighbor in the frontier bitmap and stops at the first). Bottom-up wins
+// once the frontier's edges outnumber the unexplored edges / ALPHA, because most
+// unvisited nodes then find a parent after a few probes; it switches back to
+// top-down when the frontier shrinks below nodes / BETA.
+class DirectionOptimizingBfs {
+public:
+    using Node = CsrGraph::Node;
+
+    struct Step {
+        size_t frontier;  // nodes expanded in this step
+        bool bottom_up;
+        double seconds;
+    };
+
+    DirectionOptimizingBfs(const CsrGraph& graph, int threads);
+
+    // Nodes by distance from source: levels[0] = {source}, up to max_depth
+    // (< 0: until the component is exhausted). Not thread-safe; reuses its
+    // buffers across calls.
+    std::vector<std::vector<Node>> run(Node source, int max_depth);
+
+    // how each level of the last run was expanded
+    const std::vector<Step>& steps() const { return last_steps; }
+
+    static const int ALPHA = 14;
+    static const int BETA = 24;
+
+private:
+    static const uint32_t UNSEEN = UINT32_MAX;
+
+    void top_down(const std::vector<Node>& frontier, uint32_t depth);
+    void bottom_up(const std::vector<Node>& frontier, uint32_t depth);
+    // run body(first, last, worker) over [0, count) in chunks, on up to
+    // `threads` threads, inline when the work is small
+    void parallel_for(size_t count, size_t chunk, const std::function<void(size_t, size_t, int)>& body);
+
+    const CsrGraph& graph;
+    int threads;
+    std::unique_ptr<std::atomic<uint32_t>[]> depth_of;
+    std::vector<uint64_t> in_frontier; // bitmap for bottom-up steps
+    std::vector<std::vector<Node>> found; // per worker, next frontier
+    std::vector<Step> last_steps;
+};
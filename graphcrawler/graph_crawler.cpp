@@ -1,91 +1,87 @@
 #include <iostream>
-#include <queue>
-#include <unordered_set>
 #include <vector>
 #include <string>
-#include <curl/curl.h>
-#include <rapidjson/document.h>
 #include <chrono>
+#include <memory>
+#include <stdexcept>
+#include "crawler.h"
 
 using namespace std;
-using namespace rapidjson;
 
-const string BASE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
-
-// store api response
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
+void usage(const char* prog) {
+    cout << "Usage: " << prog << " <start_node> <depth> " << CacheOptions::usage() << " " << FetchOptions::usage()
+         << " " << TelemetryOptions::usage() << "\n";
 }
 
-// fetch neighbors
-vector<string> fetch_neighbors(const string& node) {
-    CURL* curl;
-    CURLcode res;
-    string readBuffer;
-    vector<string> neighbors;
-
-    curl = curl_easy_init();
-    if (curl) {
-        string url = BASE_URL + node;
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
 
-        if (res == CURLE_OK) {
-            Document d;
-            d.Parse(readBuffer.c_str());
+    string start_node = argv[1];
+    int max_depth;
 
-            if (d.HasMember("neighbors") && d["neighbors"].IsArray()) {
-                for (auto& v : d["neighbors"].GetArray()) {
-                    neighbors.push_back(v.GetString());
-                }
+    CacheOptions cache_options;
+    FetchOptions fetch_options;
+    TelemetryOptions telemetry_options;
+    unique_ptr<NeighborCache> cache;
+    try {
+        max_depth = stoi(argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            if (!cache_options.parse(argc, argv, i) && !fetch_options.parse(argc, argv, i) &&
+                !telemetry_options.parse(argc, argv, i)) {
+                cout << "Unknown option: " << argv[i] << "\n";
+                return 1;
             }
         }
+    } catch (const exception& e) {
+        cerr << "Error: Depth and option values must be numbers.\n";
+        usage(argv[0]);
+        return 1;
     }
-    return neighbors;
-}
-
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        cout << "Usage: " << argv[0] << " <start_node> <depth>\n";
+    try {
+        cache = cache_options.open();
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        usage(argv[0]);
         return 1;
     }
-
-    string start_node = argv[1];
-    int max_depth = stoi(argv[2]);
+    unique_ptr<Telemetry> telemetry = telemetry_options.open();
     // start time measurement
     auto start_time = chrono::high_resolution_clock::now();
 
-    queue<pair<string, int>> q;
-    unordered_set<string> visited;
-
-    q.push({start_node, 0});
-    visited.insert(start_node);
-
-    while (!q.empty()) {
-        auto [current, depth] = q.front();
-        q.pop();
-
-        cout << current << " (depth " << depth << ")\n";
-
-        if (depth < max_depth) {
-            vector<string> neighbors = fetch_neighbors(current);
-            for (const auto& neighbor : neighbors) {
-                if (visited.find(neighbor) == visited.end()) {
-                    visited.insert(neighbor);
-                    q.push({neighbor, depth + 1});
-                }
-            }
-        }
+    // one keep-alive handle for the whole traversal, walked in FIFO order
+    RateController rate(fetch_options.rate);
+    FetchContext context{fetch_options.service_url, nullptr, &rate, telemetry.get()};
+    HttpSource http(context);
+    unique_ptr<NeighborSource> cached;
+    if (cache)
+        cached = make_unique<CachedSource>(*cache, &http);
+    NeighborSource& source = cached ? *cached : http;
+    StringInterner names;
+    SequentialEngine engine({1, telemetry.get(), nullptr});
+    vector<vector<NodeId>> levels;
+    try {
+        levels = engine.crawl(source, names, start_node, max_depth);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
+
+    for (size_t depth = 0; depth < levels.size(); ++depth)
+        for (NodeId id : levels[depth])
+            cout << names.name(id) << " (depth " << depth << ")\n";
     // end time measurement
     auto end_time = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed = end_time - start_time;
     cout << "\nTraversal completed in " << elapsed.count() << " seconds.\n";
+    rate.report(cerr);
+    try {
+        telemetry_options.finish(telemetry.get(), elapsed.count());
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+    }
 
     return 0;
 }
@@ -1,210 +1,527 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <queue>
 #include <unordered_set>
 #include <cstdio>
 #include <cstdlib>
 #include <curl/curl.h>
 #include <stdexcept>
-#include "rapidjson/error/error.h"
-#include "rapidjson/reader.h"
-
-struct ParseException : std::runtime_error, rapidjson::ParseResult {
-    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) : 
-        std::runtime_error(msg), 
-        rapidjson::ParseResult(code, offset) {}
-};
-
-#undef RAPIDJSON_PARSE_ERROR_NORETURN
-#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
-    throw ParseException(code, #code, offset)
-
-#include <rapidjson/document.h>
+#include "neighbor_parser.h"
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <cctype>
+#include "http_client.h"
+#include "multi_fetcher.h"
+#include "neighbor_cache.h"
+#include "string_interner.h"
+#include "atomic_bitmap.h"
+#include "output_sink.h"
+#include "checkpoint.h"
+#include "csr_graph.h"
+#include "crawl_limits.h"
+#include "level_pool.h"
+#include "crawler.h"
 
 using namespace std;
-using namespace rapidjson;
 
 bool debug = false;
 
-// Updated service URL
-const string SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
-
-// Function to HTTP encode parts of URLs. for instance, replace spaces with '%20' for URLs
-string url_encode(CURL* curl, string input) {
-  char* out = curl_easy_escape(curl, input.c_str(), input.size());
-  string s = out;
-  curl_free(out);
-  return s;
-}
-
-// Callback function for writing response data
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
-}
-
-// Function to fetch neighbors using libcurl with debugging
-string fetch_neighbors(CURL* curl, const string& node) {
-    string url = SERVICE_URL + url_encode(curl, node);
-    string response;
+// Expands a whole frontier on either engine for path mode. Nodes are handed out
+// from an atomic cursor so the expansion can stop part way through a level.
+class FrontierExpander {
+public:
+  // called from the worker that fetched `from`, once per neighbor name
+  using Visit = function<void(int worker, NodeId from, string_view neighbor)>;
+
+  FrontierExpander(const FetchContext& context, StringInterner& names, NeighborCache* cache,
+                   int max_in_flight, int loop_threads)
+      : names(names), cache(cache), telemetry(context.telemetry) {
+    if (max_in_flight > 0) {
+      multi = make_unique<MultiFetcher>(max_in_flight, std::min(2, loop_threads), context);
+      for (int l = 0; l < multi->loop_count(); ++l)
+        parsers.push_back(make_unique<NeighborParser>());
+    } else {
+      pool = make_unique<LevelPool>(8);
+      for (int t = 0; t < pool->size(); ++t)
+        fetchers.push_back(make_unique<NeighborFetcher>(context));
+    }
+  }
 
-    if (debug)
-      cout << "Sending request to: " << url << endl;
+  int workers() const { return multi ? multi->loop_count() : fetchers.size(); }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  // number of nodes expanded so far (fetched or served from the cache)
+  size_t expanded() const { return count.load(); }
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  // Expand every node of frontier unless stop gets set, which ends the
+  // expansion as soon as the nodes already being fetched are done.
+  void expand(const vector<NodeId>& frontier, const Visit& visit, const atomic<bool>& stop) {
+    if (multi)
+      expand_multi(frontier, visit, stop);
+    else
+      expand_threads(frontier, visit, stop);
+  }
 
-    CURLcode res = curl_easy_perform(curl);
+private:
+  void expand_threads(const vector<NodeId>& frontier, const Visit& visit, const atomic<bool>& stop) {
+    pool->run(frontier.size(), [&](int tid, size_t i) {
+      if (stop.load(memory_order_relaxed))
+        return false;
+      NeighborFetcher& fetcher = *fetchers[tid];
+      NodeId u = frontier[i];
+      const string& s = names.name(u);
+      ++count;
+      for_each_neighbor(cache, s,
+        [&](auto emit) { return fetcher.fetch(s, emit); },
+        [&](string_view neighbor) { visit(tid, u, neighbor); });
+      return true;
+    });
+  }
 
-    if (res != CURLE_OK) {
-        cerr << "CURL error: " << curl_easy_strerror(res) << endl;
-    } else {
-      if (debug)
-        cout << "CURL request successful!" << endl;
+  void expand_multi(const vector<NodeId>& frontier, const Visit& visit, const atomic<bool>& stop) {
+    // cached nodes first, they cost nothing
+    vector<NodeId> to_fetch;
+    for (NodeId u : frontier) {
+      if (stop.load(memory_order_relaxed))
+        return;
+      if (cache && cache->lookup_each(names.name(u), [&](string_view n) { visit(0, u, n); }))
+        ++count;
+      else if (!cache || !cache->offline())
+        to_fetch.push_back(u);
     }
 
-    curl_slist_free_all(headers);
-
-    if (debug) 
-      cout << "Response received: " << response << endl;
+    auto name_of = [&](size_t i) -> const string& { return names.name(to_fetch[i]); };
+    multi->fetch_all(to_fetch.size(), name_of, [&](size_t i, string& response, bool ok, int loop) {
+      NodeId u = to_fetch[i];
+      const string& s = names.name(u);
+      ++count;
+      vector<string> fetched;
+      bool store = ok && cache;
+      bool is_object;
+      {
+        ParseTimer timer(telemetry);
+        is_object = parsers[loop]->parse(response, [&](string_view n) {
+          if (store)
+            fetched.emplace_back(n);
+          visit(loop, u, n);
+        });
+      }
+      if (!is_object)
+        cerr << "Invalid JSON object for: " << s << endl;
+      if (store)
+        cache->store(s, fetched);
+    }, &stop);
+  }
 
-    return (res == CURLE_OK) ? response : "{}";
-}
+  StringInterner& names;
+  NeighborCache* cache;
+  Telemetry* telemetry;
+  vector<unique_ptr<NeighborFetcher>> fetchers;
+  unique_ptr<LevelPool> pool; // thread engine: started once, reused for every frontier
+  unique_ptr<MultiFetcher> multi;
+  vector<unique_ptr<NeighborParser>> parsers;
+  atomic<size_t> count{0};
+};
 
-// Function to parse JSON and extract neighbors
-vector<string> get_neighbors(const string& json_str) {
-    vector<string> neighbors;
-    try {
-        Document doc;
-        doc.Parse(json_str.c_str());
+const NodeId NO_NODE = UINT32_MAX;
 
-        if (!doc.IsObject()) {
-            cerr << "Invalid JSON object: " << json_str << endl;
-            return {};
-        }
+// One end of a bidirectional search
+struct SearchSide {
+  AtomicBitmap visited;
+  vector<NodeId> parent; // indexed by NodeId, NO_NODE for the root and unseen nodes
+  vector<NodeId> frontier;
+  int depth = 0;
+};
 
-        if (doc.HasMember("neighbors") && doc["neighbors"].IsArray()) {
-            for (const auto& neighbor : doc["neighbors"].GetArray())
-                neighbors.push_back(neighbor.GetString());
-        }
-    } catch (const ParseException& e) {
-        std::cerr << "Error while parsing JSON: " << json_str << std::endl;
-        throw e;
-    }
-    return neighbors;
-}
+// Shortest path from -> to by bidirectional BFS, treating the graph as
+// undirected (actor <-> movie). Each step expands the smaller frontier by one
+// level and stops at the first node the other side has already reached; by
+// then every shorter meeting would have been seen, so that path is a shortest
+// one. Empty if there is none within max_hops (0 = no limit).
+vector<NodeId> shortest_path(FrontierExpander& expander, StringInterner& names, const string& from,
+                             const string& to, int max_hops) {
+  NodeId ends[2] = {names.intern(from), names.intern(to)};
+  if (ends[0] == ends[1])
+    return {ends[0]};
+
+  SearchSide sides[2];
+  for (int k = 0; k < 2; ++k) {
+    sides[k].frontier.push_back(ends[k]);
+    sides[k].visited.test_and_set(ends[k]);
+  }
 
-// BFS Traversal Function
-vector<vector<string>> bfs(CURL* unused, const string& start, int depth) {
-  vector<vector<string>> levels;
-  unordered_set<string> visited;
-  mutex visited_mutex;
-  mutex level_mutex;
+  while (!sides[0].frontier.empty() && !sides[1].frontier.empty()) {
+    if (max_hops > 0 && sides[0].depth + sides[1].depth >= max_hops)
+      return {};
+    int k = sides[0].frontier.size() <= sides[1].frontier.size() ? 0 : 1;
+    SearchSide& near = sides[k];
+    SearchSide& far = sides[1 - k];
+    if (debug)
+      std::cout << "expanding " << near.frontier.size() << " nodes from the " << (k ? "target" : "source")
+                << " side\n";
 
-  levels.push_back({start});
-  visited.insert(start);
+    atomic<bool> met(false);
+    NodeId meet_from = NO_NODE, meet_at = NO_NODE;
+    // (node, parent) discovered by each worker, merged after the expansion
+    vector<vector<pair<NodeId, NodeId>>> found(expander.workers());
 
-  for (int d = 0;  d < depth; d++) {
-    if (debug)
-      std::cout << "starting level: " << d << "\n";
-    levels.push_back({});
-    vector<string> next_level;
-    vector<string>& current_level = levels[d];
-
-    int num_nodes = current_level.size();
-    const int max_threads = 8;
-    int num_threads = std::min(max_threads, num_nodes);
-    vector<thread> threads(num_threads);
-
-    auto worker = [&](int tid) {
-      CURL* thread_curl = curl_easy_init();
-      if (!thread_curl) {
-        std::cerr << "CURL error: Failed initialization in thread " << tid << std::endl;
+    expander.expand(near.frontier, [&](int worker, NodeId u, string_view neighbor) {
+      NodeId x = names.intern(neighbor);
+      if (!near.visited.test_and_set(x))
         return;
+      found[worker].push_back({x, u});
+      if (far.visited.test(x) && !met.exchange(true)) {
+        meet_from = u;
+        meet_at = x;
       }
-
-      int chunk_size = (num_nodes + num_threads - 1) / num_threads;
-      int start_idx = tid * chunk_size;
-      int end_idx = std::min(start_idx + chunk_size, num_nodes);
-      for (int i = start_idx; i < end_idx; ++i) {
-        string& s = current_level[i];
-        try {
-          if (debug)
-            std::cout << "Trying to expand" << s << "\n";
-          for (const auto& neighbor : get_neighbors(fetch_neighbors(thread_curl, s))) {
-            if (debug)
-              std::cout << "neighbor " << neighbor << "\n";
-            std::lock_guard<std::mutex> guard1(visited_mutex);
-            if (!visited.count(neighbor)) {
-              visited.insert(neighbor);
-              std::lock_guard<std::mutex> guard2(level_mutex);
-              next_level.push_back(neighbor);
-            }
-          }
-        } catch (const ParseException& e) {
-          std::cerr << "Error while fetching neighbors of: " << s << std::endl;
-          throw e;
-        }
+    }, met);
+
+    near.parent.resize(names.size(), NO_NODE);
+    near.frontier.clear();
+    for (auto& f : found)
+      for (auto [x, u] : f) {
+        near.parent[x] = u;
+        near.frontier.push_back(x);
       }
+    near.depth++;
+
+    if (met) {
+      // meet_at back to the near root, then on to the far root
+      vector<NodeId> path;
+      for (NodeId v = meet_from; v != NO_NODE; v = v < near.parent.size() ? near.parent[v] : NO_NODE)
+        path.push_back(v);
+      std::reverse(path.begin(), path.end());
+      for (NodeId v = meet_at; v != NO_NODE; v = v < far.parent.size() ? far.parent[v] : NO_NODE)
+        path.push_back(v);
+      if (k == 1)
+        std::reverse(path.begin(), path.end());
+      return path;
+    }
+  }
+  return {};
+}
 
-      curl_easy_cleanup(thread_curl);
-    };
+// One k-hop crawl of a batch, and the file its levels go to
+struct BatchQuery {
+  string start;
+  int depth;
+  string file;
+};
 
-    for (int t = 0; t < num_threads; ++t)
-      threads[t] = std::thread(worker, t);
+// "<depth> <node_name>" per line; blank lines and lines starting with # are
+// skipped. Throws runtime_error on anything else.
+vector<BatchQuery> read_queries(const string& path) {
+  ifstream in(path);
+  if (!in)
+    throw runtime_error("Cannot read queries from " + path);
+  vector<BatchQuery> queries;
+  string line;
+  for (int n = 1; getline(in, line); ++n) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty() || line[0] == '#')
+      continue;
+    size_t space = line.find(' ');
+    try {
+      size_t used;
+      int depth = stoi(line.substr(0, space), &used);
+      if (used != space || space == string::npos || space + 1 == line.size() || depth < 0)
+        throw invalid_argument("malformed");
+      queries.push_back({line.substr(space + 1), depth, ""});
+    } catch (const logic_error& e) {
+      throw runtime_error(path + ":" + to_string(n) + ": expected <depth> <node_name>");
+    }
+  }
+  return queries;
+}
 
-    for (int t = 0; t < num_threads; ++t)
-      threads[t].join();
+// <dir>/<n>-<start with anything but letters and digits as _>.<ext>
+string query_file(const string& dir, size_t n, const string& start, OutputSink::Format format) {
+  string name = to_string(n) + "-";
+  for (char c : start)
+    name += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+  const char* ext = format == OutputSink::Format::Ndjson ? ".ndjson" : format == OutputSink::Format::Binary ? ".bin" : ".txt";
+  return (filesystem::path(dir) / (name + ext)).string();
+}
 
-    levels[d + 1] = std::move(next_level);
+// Every query's crawl at once, in rounds: round r expands level r of every
+// query still short of its depth. The frontiers' union is expanded once, and
+// each neighbor list is kept for the rest of the batch, so a node is fetched at
+// most once however many queries reach it. Visited sets and levels stay per
+// query; each query's new level goes to its own sink as its round ends.
+// Returns how many expansions the queries made between them.
+size_t batch_crawl(FrontierExpander& expander, StringInterner& names, const vector<BatchQuery>& queries,
+                   vector<unique_ptr<OutputSink>>& sinks) {
+  struct QueryState {
+    vector<bool> visited;
+    vector<NodeId> frontier;
+  };
+  vector<QueryState> states(queries.size());
+  // neighbor ids of every node expanded so far, indexed by NodeId
+  vector<vector<NodeId>> adjacency;
+  vector<uint8_t> scheduled; // expanded, or about to be in this round
+  auto name_of = [&](NodeId id) -> const string& { return names.name(id); };
+  atomic<bool> never(false);
+  size_t expansions = 0;
+
+  for (size_t q = 0; q < queries.size(); ++q) {
+    NodeId id = names.intern(queries[q].start);
+    states[q].frontier.push_back(id);
+    sinks[q]->write(queries[q].start, 0);
   }
 
-  return levels;
+  for (int r = 0;; ++r) {
+    adjacency.resize(names.size());
+    scheduled.resize(names.size(), 0);
+    vector<NodeId> need;
+    bool active = false;
+    for (size_t q = 0; q < queries.size(); ++q) {
+      if (queries[q].depth <= r || states[q].frontier.empty())
+        continue;
+      active = true;
+      for (NodeId u : states[q].frontier)
+        if (!scheduled[u]) {
+          scheduled[u] = 1;
+          need.push_back(u);
+        }
+    }
+    if (!active)
+      break;
+    if (debug)
+      std::cout << "round " << r << ": expanding " << need.size() << " nodes\n";
+
+    // each node is expanded by exactly one worker, which alone fills its list
+    expander.expand(need, [&](int, NodeId u, string_view neighbor) {
+      adjacency[u].push_back(names.intern(neighbor));
+    }, never);
+
+    for (size_t q = 0; q < queries.size(); ++q) {
+      QueryState& state = states[q];
+      if (queries[q].depth <= r || state.frontier.empty())
+        continue;
+      state.visited.resize(names.size(), false);
+      if (r == 0)
+        state.visited[state.frontier[0]] = true;
+      vector<NodeId> next;
+      for (NodeId u : state.frontier)
+        for (NodeId v : adjacency[u])
+          if (!state.visited[v]) {
+            state.visited[v] = true;
+            next.push_back(v);
+          }
+      sinks[q]->write_all(next.begin(), next.end(), r + 1, name_of);
+      expansions += state.frontier.size();
+      state.frontier = std::move(next);
+    }
+  }
+  return expansions;
+}
+
+void usage(const char* prog) {
+    cerr << "Usage: " << prog << " <node_name> <depth> [--multi <max_in_flight>] [--loops <1|2>]\n"
+         << "       " << prog << " path <from> <to> [--max-hops <n>] [--multi <max_in_flight>] [--loops <1|2>]\n"
+         << "       " << prog << " batch <queries.txt> [--out-dir <dir>] [--format text|ndjson|binary]\n"
+         << "       " << "    [--multi <max_in_flight>] [--loops <1|2>]  (queries: \"<depth> <node_name>\" per line)\n"
+         << "       " << CacheOptions::usage() << "\n"
+         << "       " << FetchOptions::usage() << "\n"
+         << "       " << TelemetryOptions::usage() << "\n"
+         << "       " << OutputOptions::usage() << " (crawl mode)\n"
+         << "       " << CheckpointOptions::usage() << " (crawl mode)\n"
+         << "       " << LimitOptions::usage() << " (crawl mode)\n"
+         << "       [--export-csr <graph.csr>] (crawl mode)\n";
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        cerr << "Usage: " << argv[0] << " <node_name> <depth>\n";
+    // path mode: shortest path between two nodes instead of a k-hop crawl;
+    // batch mode: many k-hop crawls sharing their fetches
+    bool path_mode = argc > 1 && string(argv[1]) == "path";
+    bool batch_mode = argc > 1 && string(argv[1]) == "batch";
+    bool crawl_mode = !path_mode && !batch_mode;
+    int first_option = path_mode ? 4 : 3;
+    if (argc < first_option) {
+        usage(argv[0]);
         return 1;
     }
 
-    // Global init for libcurl
-    curl_global_init(CURL_GLOBAL_ALL);
+    string start_node = argv[crawl_mode ? 1 : 2]; // batch mode: the queries file
+    string target_node = path_mode ? argv[3] : "";
+    int depth = 0;
+    int max_hops = 0; // path mode: 0 searches until a frontier runs out
+    int max_in_flight = 0; // 0 keeps the thread-pool engine
+    int loop_threads = 1;
+    string csr_path; // crawl mode: write the crawled subgraph here
+    string out_dir = "."; // batch mode: one file per query here
+    CacheOptions cache_options;
+    FetchOptions fetch_options;
+    TelemetryOptions telemetry_options;
+    OutputOptions output_options;
+    CheckpointOptions checkpoint_options;
+    LimitOptions limit_options;
+    try {
+        if (crawl_mode)
+            depth = stoi(argv[2]);
+        for (int i = first_option; i < argc; ++i) {
+            string opt = argv[i];
+            if (cache_options.parse(argc, argv, i) || fetch_options.parse(argc, argv, i) ||
+                telemetry_options.parse(argc, argv, i) || output_options.parse(argc, argv, i) ||
+                checkpoint_options.parse(argc, argv, i) || limit_options.parse(argc, argv, i))
+                continue;
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            if (opt == "--multi")
+                max_in_flight = stoi(argv[++i]);
+            else if (opt == "--loops")
+                loop_threads = stoi(argv[++i]);
+            else if (opt == "--max-hops" && path_mode)
+                max_hops = stoi(argv[++i]);
+            else if (opt == "--export-csr" && crawl_mode)
+                csr_path = argv[++i];
+            else if (opt == "--out-dir" && batch_mode)
+                out_dir = argv[++i];
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: Depth and option values must be numbers, --format one of text, ndjson, binary,\n"
+             << "--priority one of degree, none.\n";
+        return 1;
+    }
 
-    string start_node = argv[1];
-    int depth;
+    unique_ptr<NeighborCache> cache;
+    unique_ptr<OutputSink> sink;
+    unique_ptr<CrawlCheckpoint> checkpoint;
+    StringInterner names;
+    CrawlState resumed; // empty: start from scratch
+    vector<BatchQuery> queries;
+    vector<unique_ptr<OutputSink>> query_sinks;
     try {
-        depth = stoi(argv[2]);
+        cache = cache_options.open();
+        if (crawl_mode) {
+            sink = output_options.open();
+            checkpoint = checkpoint_options.open();
+        }
+        if (batch_mode) {
+            if (!output_options.path.empty())
+                throw runtime_error("batch mode writes one file per query; use --out-dir <dir>");
+            queries = read_queries(start_node);
+            filesystem::create_directories(out_dir);
+            for (size_t q = 0; q < queries.size(); ++q) {
+                queries[q].file = query_file(out_dir, q + 1, queries[q].start, output_options.format);
+                query_sinks.push_back(make_unique<OutputSink>(queries[q].file, output_options.format));
+            }
+        }
+        if (!csr_path.empty() && checkpoint_options.resume)
+            throw runtime_error("--export-csr needs the whole crawl and can't be combined with --resume");
+        resumed = checkpoint_options.resumed(checkpoint.get(), start_node, names);
     } catch (const exception& e) {
-        cerr << "Error: Depth must be an integer.\n";
+        cerr << "Error: " << e.what() << "\n";
         return 1;
     }
 
+    unique_ptr<Telemetry> telemetry = telemetry_options.open();
+    // the deadline counts from here
+    unique_ptr<CrawlLimits> limits = crawl_mode ? limit_options.open() : nullptr;
+    unique_ptr<FrontierPriority> priority = limit_options.open_priority();
+    FetchScope fetch(fetch_options, telemetry.get());
+    const FetchContext& context = fetch.context();
     const auto start = std::chrono::steady_clock::now(); // start timing
 
     // std::cout << "===== BFS up to depth " << depth << " =====" << std::endl;
 
-    for (const auto& n : bfs(nullptr, start_node, depth)) {
-        for (const auto& node : n)
-            cout << "- " << node << "\n";
-        std::cout << n.size() << "\n";
+    vector<vector<NodeId>> levels;
+    vector<NodeId> path;
+    size_t expanded = 0;
+    size_t batch_expansions = 0;
+    unique_ptr<EdgeList> edges;
+    if (!csr_path.empty())
+        edges = make_unique<EdgeList>();
+    try {
+        if (path_mode) {
+            FrontierExpander expander(context, names, cache.get(), max_in_flight, loop_threads);
+            path = shortest_path(expander, names, start_node, target_node, max_hops);
+            expanded = expander.expanded();
+        } else if (batch_mode) {
+            FrontierExpander expander(context, names, cache.get(), max_in_flight, loop_threads);
+            batch_expansions = batch_crawl(expander, names, queries, query_sinks);
+            expanded = expander.expanded();
+        } else {
+            HttpSource http(context, limits.get());
+            unique_ptr<NeighborSource> cached;
+            if (cache)
+                cached = make_unique<CachedSource>(*cache, &http);
+            EngineConfig config{8, telemetry.get(), sink.get()};
+            config.checkpoint = checkpoint.get();
+            config.resume = &resumed;
+            config.edges = edges.get();
+            config.limits = limits.get();
+            config.priority = priority.get();
+            config.max_in_flight = max_in_flight;
+            config.loops = loop_threads;
+            unique_ptr<TraversalEngine> engine;
+            if (max_in_flight > 0)
+                engine = make_unique<MultiEngine>(config);
+            else
+                engine = make_unique<LevelSyncEngine>(config);
+            levels = engine->crawl(cached ? *cached : http, names, start_node, depth);
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        if (checkpoint)
+            cerr << "Progress is saved in " << checkpoint->file() << "; rerun with --resume to continue\n";
+        return 1;
     }
 
-    const auto finish = std::chrono::steady_clock::now(); // end timing and print elapsed
-    const std::chrono::duration<double> elapsed_seconds = finish - start;
-    std::cout << "Time to crawl: " << elapsed_seconds.count() << "s\n";
+    if (path_mode) {
+        if (path.empty()) {
+            cout << "No path from " << start_node << " to " << target_node;
+            if (max_hops > 0)
+                cout << " within " << max_hops << " hops";
+            cout << "\n";
+        } else {
+            for (NodeId id : path)
+                cout << "- " << names.name(id) << "\n";
+            cout << "Hops: " << path.size() - 1 << "\n";
+        }
+        cout << "Nodes expanded: " << expanded << "\n";
+    }
+    if (batch_mode) {
+        for (size_t q = 0; q < queries.size(); ++q) {
+            try {
+                query_sinks[q]->close();
+            } catch (const exception& e) {
+                cerr << "Error: " << e.what() << "\n";
+            }
+            cout << "Query " << q + 1 << ": " << queries[q].start << ", depth " << queries[q].depth << ":";
+            for (uint64_t count : query_sinks[q]->depth_counts())
+                cout << " " << count;
+            cout << " nodes by level -> " << queries[q].file << "\n";
+        }
+        cout << "Nodes expanded: " << expanded << " for " << batch_expansions << " expansions by " << queries.size()
+             << " queries\n";
+    }
 
-    curl_global_cleanup();
+    double seconds = report_crawl(levels, names, sink.get(), limits.get(), start);
+    if (cache)
+        cerr << "Neighbor cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    fetch.rate().report(cerr);
+    if (edges)
+        export_edges(*edges, csr_path, names);
+    try {
+        telemetry_options.finish(telemetry.get(), seconds);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+    }
 
     return 0;
 }
@@ -0,0 +1,284 @@
+#include <mpi.h>
+
+#include <curl/curl.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "neighbor_parser.h"
+#include "http_client.h"
+#include "multi_fetcher.h"
+#include "neighbor_cache.h"
+#include "string_interner.h"
+#include "atomic_bitmap.h"
+
+using namespace std;
+
+// Distributed level-synchronous crawl. Every MPI rank owns the node names that
+// hash to it and only ever fetches those, from its own connections and under
+// its own rate limit. Neighbors of a level are routed to their owners in one
+// batched all-to-all exchange at the level boundary; the owner alone decides
+// whether a name is new, so every node lands in exactly one rank's next level.
+
+// Rank that owns name: FNV-1a, so every rank agrees whatever its build.
+int owner(string_view name, int ranks) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (char c : name) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ull;
+  }
+  return h % ranks;
+}
+
+// names as u32 length + bytes
+void pack(string& out, string_view name) {
+  uint32_t n = name.size();
+  out.append(reinterpret_cast<const char*>(&n), sizeof n);
+  out += name;
+}
+
+template <class Emit>
+void unpack(const char* p, const char* end, Emit emit) {
+  while (p < end) {
+    uint32_t n;
+    memcpy(&n, p, sizeof n);
+    emit(string_view(p + sizeof n, n));
+    p += sizeof n + n;
+  }
+}
+
+// Send outbox[r] to rank r and return everything sent to this rank.
+string exchange(vector<string>& outbox, MPI_Comm comm) {
+  int ranks = outbox.size();
+  vector<int> send_counts(ranks), send_displs(ranks), recv_counts(ranks), recv_displs(ranks);
+  string send;
+  for (int r = 0; r < ranks; ++r) {
+    send_displs[r] = send.size();
+    send_counts[r] = outbox[r].size();
+    send += outbox[r];
+    outbox[r].clear();
+  }
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+  size_t total = 0;
+  for (int r = 0; r < ranks; ++r) {
+    recv_displs[r] = total;
+    total += recv_counts[r];
+  }
+  string received(total, '\0');
+  MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), MPI_CHAR, &received[0], recv_counts.data(),
+                recv_displs.data(), MPI_CHAR, comm);
+  return received;
+}
+
+// Collect every rank's `packed` names at rank 0 (empty elsewhere).
+string gather(const string& packed, int rank, int ranks, MPI_Comm comm) {
+  int count = packed.size();
+  vector<int> counts(ranks), displs(ranks);
+  MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+  size_t total = 0;
+  for (int r = 0; r < ranks; ++r) {
+    displs[r] = total;
+    total += counts[r];
+  }
+  string all(rank == 0 ? total : 0, '\0');
+  MPI_Gatherv(packed.data(), count, MPI_CHAR, &all[0], counts.data(), displs.data(), MPI_CHAR, 0, comm);
+  return all;
+}
+
+struct RankStats {
+  uint64_t expanded = 0;
+  uint64_t sent = 0;     // names routed to other ranks
+  uint64_t received = 0; // names other ranks routed here
+};
+
+// This rank's share of each level.
+vector<vector<NodeId>> partitioned_bfs(MultiFetcher& fetcher, StringInterner& names, const string& start,
+                                       int depth, NeighborCache* cache, int rank, int ranks, RankStats& stats) {
+  vector<vector<NodeId>> levels(1);
+  AtomicBitmap visited; // nodes this rank owns and has placed in a level
+  AtomicBitmap sent;    // other ranks' nodes already routed to them
+  vector<string> outbox(ranks);
+  mutex outbox_mutex;
+  vector<unique_ptr<NeighborParser>> parsers;
+  for (int l = 0; l < fetcher.loop_count(); ++l)
+    parsers.push_back(make_unique<NeighborParser>());
+
+  if (owner(start, ranks) == rank) {
+    NodeId id = names.intern(start);
+    visited.test_and_set(id);
+    levels[0].push_back(id);
+  }
+
+  for (int d = 0; d < depth; d++) {
+    levels.push_back({});
+    vector<NodeId>& next_level = levels[d + 1];
+
+    // own nodes go straight into the next level, others are batched for their
+    // owner; names already routed once are not sent again
+    auto route = [&](string_view neighbor) {
+      int to = owner(neighbor, ranks);
+      NodeId id = names.intern(neighbor);
+      if (to == rank) {
+        if (visited.test_and_set(id))
+          next_level.push_back(id);
+      } else if (sent.test_and_set(id)) {
+        pack(outbox[to], neighbor);
+        stats.sent++;
+      }
+    };
+
+    vector<NodeId> to_fetch;
+    for (NodeId id : levels[d]) {
+      if (cache && cache->lookup_each(names.name(id), route))
+        stats.expanded++;
+      else if (!cache || !cache->offline())
+        to_fetch.push_back(id);
+    }
+
+    auto name_of = [&](size_t i) -> const string& { return names.name(to_fetch[i]); };
+    fetcher.fetch_all(to_fetch.size(), name_of, [&](size_t i, string& response, bool ok, int loop) {
+      const string& s = name_of(i);
+      vector<string> fetched; // only kept for the cache write-through
+      bool store = ok && cache;
+      lock_guard<mutex> lock(outbox_mutex);
+      try {
+        if (!parsers[loop]->parse(response, [&](string_view n) {
+              if (store)
+                fetched.emplace_back(n);
+              route(n);
+            }))
+          cerr << "Invalid JSON object for: " << s << endl;
+      } catch (const ParseException& e) {
+        std::cerr << "Error while fetching neighbors of: " << s << std::endl;
+        throw;
+      }
+      if (store)
+        cache->store(s, fetched);
+      stats.expanded++;
+    });
+
+    // level boundary: hand every routed name to its owner in one exchange
+    string received = exchange(outbox, MPI_COMM_WORLD);
+    unpack(received.data(), received.data() + received.size(), [&](string_view name) {
+      stats.received++;
+      NodeId id = names.intern(name);
+      if (visited.test_and_set(id))
+        next_level.push_back(id);
+    });
+  }
+  return levels;
+}
+
+void usage(const char* prog) {
+  cerr << "Usage: mpirun -np <ranks> " << prog << " <node_name> <depth> [--multi <max_in_flight per rank>]\n"
+       << "       " << CacheOptions::usage() << " (one file per rank: <file>.<rank>)\n"
+       << "       " << FetchOptions::usage() << " (--max-rate is per rank)\n";
+}
+
+int main(int argc, char* argv[]) {
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  int rank, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  if (argc < 3) {
+    if (rank == 0)
+      usage(argv[0]);
+    MPI_Finalize();
+    return 1;
+  }
+
+  string start_node = argv[1];
+  int depth = 0;
+  int max_in_flight = 32;
+  CacheOptions cache_options;
+  FetchOptions fetch_options;
+  try {
+    depth = stoi(argv[2]);
+    for (int i = 3; i < argc; ++i) {
+      string opt = argv[i];
+      if (cache_options.parse(argc, argv, i) || fetch_options.parse(argc, argv, i))
+        continue;
+      if (opt == "--multi" && i + 1 < argc) {
+        max_in_flight = stoi(argv[++i]);
+      } else {
+        if (rank == 0)
+          usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+      }
+    }
+  } catch (const exception& e) {
+    if (rank == 0)
+      cerr << "Error: Depth and option values must be numbers.\n";
+    MPI_Finalize();
+    return 1;
+  }
+
+  // nodes are hash-owned, so a node always lands in the same rank's file
+  if (!cache_options.path.empty() && ranks > 1)
+    cache_options.path += "." + to_string(rank);
+  unique_ptr<NeighborCache> cache;
+  try {
+    cache = cache_options.open();
+  } catch (const exception& e) {
+    cerr << "Error: " << e.what() << "\n";
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  FetchScope fetch(fetch_options, nullptr);
+  MPI_Barrier(MPI_COMM_WORLD);
+  const auto start = std::chrono::steady_clock::now(); // start timing
+
+  StringInterner names;
+  vector<vector<NodeId>> levels;
+  RankStats stats;
+  try {
+    MultiFetcher fetcher(max_in_flight, 1, fetch.context());
+    levels = partitioned_bfs(fetcher, names, start_node, depth, cache.get(), rank, ranks, stats);
+  } catch (const exception& e) {
+    cerr << "Error on rank " << rank << ": " << e.what() << "\n";
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // rank 0 prints every level in level_client's format
+  for (const auto& level : levels) {
+    string packed;
+    for (NodeId id : level)
+      pack(packed, names.name(id));
+    string all = gather(packed, rank, ranks, MPI_COMM_WORLD);
+    if (rank == 0) {
+      size_t count = 0;
+      unpack(all.data(), all.data() + all.size(), [&](string_view name) {
+        cout << "- " << name << "\n";
+        ++count;
+      });
+      cout << count << "\n";
+    }
+  }
+
+  const auto finish = std::chrono::steady_clock::now(); // end timing and print elapsed
+  const std::chrono::duration<double> elapsed_seconds = finish - start;
+  uint64_t mine[3] = {stats.expanded, stats.sent, stats.received};
+  vector<uint64_t> all_stats(3 * ranks);
+  MPI_Gather(mine, 3, MPI_UINT64_T, all_stats.data(), 3, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  if (rank == 0) {
+    std::cout << "Time to crawl: " << elapsed_seconds.count() << "s\n";
+    for (int r = 0; r < ranks; ++r)
+      cerr << "Rank " << r << ": expanded " << all_stats[3 * r] << " nodes, sent " << all_stats[3 * r + 1]
+           << " names, received " << all_stats[3 * r + 2] << "\n";
+  }
+  fetch.rate().report(cerr);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -3,71 +3,76 @@
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <algorithm>
 
 using namespace std;
 
-// Merge function to merge two halves
-void merge(vector<int>& arr, int left, int mid, int right) {
-    int n1 = mid - left + 1;
-    int n2 = right - mid;
-
-    vector<int> L(n1), R(n2);
-    
-    for (int i = 0; i < n1; i++)
-        L[i] = arr[left + i];
-    for (int j = 0; j < n2; j++)
-        R[j] = arr[mid + 1 + j];
-
-    int i = 0, j = 0, k = left;
-    while (i < n1 && j < n2) {
-        if (L[i] <= R[j]) {
-            arr[k] = L[i];
+// Merge src[left..mid] and src[mid+1..right] into dst[left..right]
+void mergeInto(const int* src, int* dst, long long left, long long mid, long long right) {
+    long long i = left, j = mid + 1, k = left;
+    while (i <= mid && j <= right) {
+        if (src[i] <= src[j]) {
+            dst[k] = src[i];
             i++;
         } else {
-            arr[k] = R[j];
+            dst[k] = src[j];
             j++;
         }
         k++;
     }
-    
-    while (i < n1) {
-        arr[k] = L[i];
+
+    while (i <= mid) {
+        dst[k] = src[i];
         i++;
         k++;
     }
-    while (j < n2) {
-        arr[k] = R[j];
+    while (j <= right) {
+        dst[k] = src[j];
         j++;
         k++;
     }
 }
 
-// Merge Sort function
-void mergeSort(vector<int>& arr, int left, int right) {
+// Sort [left..right] into dst, with src as scratch; both must hold the same
+// elements there on entry. Each level sorts its halves into src, roles swapped,
+// and merges them back into dst, so the two buffers alternate ("ping-pong")
+// and nothing is allocated or copied back along the way.
+void sortInto(int* src, int* dst, long long left, long long right) {
     if (left < right) {
-        int mid = left + (right - left) / 2;
-        mergeSort(arr, left, mid);
-        mergeSort(arr, mid + 1, right);
-        merge(arr, left, mid, right);
+        long long mid = left + (right - left) / 2;
+        sortInto(dst, src, left, mid);
+        sortInto(dst, src, mid + 1, right);
+        mergeInto(src, dst, left, mid, right);
     }
 }
 
+// Merge Sort function: aux is the one auxiliary buffer, at least arr's size
+void mergeSort(vector<int>& arr, vector<int>& aux) {
+    copy(arr.begin(), arr.end(), aux.begin());
+    sortInto(aux.data(), arr.data(), 0, (long long)arr.size() - 1);
+}
+
+void mergeSort(vector<int>& arr) {
+    vector<int> aux(arr.size());
+    mergeSort(arr, aux);
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         cerr << "Usage: " << argv[0] << " <array_size>\n";
         return 1;
     }
 
-    int size = atoi(argv[1]);
+    long long size = atoll(argv[1]);
     vector<int> arr(size);
     srand(time(0));
 
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         arr[i] = rand() % 10000; // Random numbers between 0 and 9999
     }
 
     auto start = chrono::high_resolution_clock::now();
-    mergeSort(arr, 0, size - 1);
+    mergeSort(arr);
     auto end = chrono::high_resolution_clock::now();
 
     chrono::duration<double> duration = end - start;
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed-size fork-join pool with work stealing, for divide-and-conquer
+// recursions that would otherwise start a thread per split.
+//
+// Each worker owns a deque of forked tasks: it pushes and pops at the back,
+// so it works depth-first on its own splits, while idle workers steal from the
+// front, where the largest pieces are. A worker waiting in a join runs other
+// tasks instead of blocking, so the pool never needs more threads than cores.
+// The thread that calls run() is worker 0.
+class ForkJoinPool {
+public:
+    explicit ForkJoinPool(int threads) : queues(std::max(1, threads)) {
+        for (int w = 1; w < size(); ++w)
+            workers.emplace_back([this, w] { worker(w); });
+    }
+
+    ~ForkJoinPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers)
+            t.join();
+    }
+
+    ForkJoinPool(const ForkJoinPool&) = delete;
+    ForkJoinPool& operator=(const ForkJoinPool&) = delete;
+
+    int size() const { return int(queues.size()); }
+
+    // Run root on the calling thread, with the other workers stealing what it
+    // forks, and return once all of it is done. Not reentrant.
+    template <class F>
+    void run(F&& root) {
+        Binding bind(this, 0);
+        {
+            std::lock_guard<std::mutex> lock(m);
+            active = true;
+        }
+        wake.notify_all();
+        try {
+            root();
+        } catch (...) {
+            active = false;
+            throw;
+        }
+        active = false;
+    }
+
+    // Run a and b, possibly in parallel, and return when both are done: b is
+    // made stealable, a runs here, then b runs here too unless a thief took
+    // it, in which case this worker helps with other tasks until b finishes.
+    // Outside run() both simply run in turn. Rethrows a's exception, else b's.
+    template <class A, class B>
+    void fork_join(A&& a, B&& b) {
+        if (current().pool != this) {
+            a();
+            b();
+            return;
+        }
+        const int w = current().worker;
+        Task task(b);
+        push(w, &task);
+        std::exception_ptr error;
+        try {
+            a();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // a joined everything it forked, so b is on top unless stolen
+        if (pop(w) == &task) {
+            execute(&task);
+        } else {
+            while (!task.done.load(std::memory_order_acquire)) {
+                if (Task* other = steal(w))
+                    execute(other);
+                else
+                    std::this_thread::yield();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+private:
+    struct Task {
+        template <class F>
+        explicit Task(F& f) : call([](void* p) { (*static_cast<F*>(p))(); }), fn(&f) {}
+        void (*call)(void*);
+        void* fn;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex m;
+        std::deque<Task*> tasks;
+    };
+
+    // which pool and worker the running thread belongs to
+    struct Current {
+        ForkJoinPool* pool = nullptr;
+        int worker = 0;
+    };
+    static Current& current() {
+        static thread_local Current c;
+        return c;
+    }
+
+    struct Binding {
+        Binding(ForkJoinPool* pool, int w) : saved(current()) { current() = {pool, w}; }
+        ~Binding() { current() = saved; }
+        Current saved;
+    };
+
+    void push(int w, Task* task) {
+        std::lock_guard<std::mutex> lock(queues[w].m);
+        queues[w].tasks.push_back(task);
+    }
+
+    Task* pop(int w) {
+        std::lock_guard<std::mutex> lock(queues[w].m);
+        if (queues[w].tasks.empty())
+            return nullptr;
+        Task* task = queues[w].tasks.back();
+        queues[w].tasks.pop_back();
+        return task;
+    }
+
+    // Take the oldest task of another worker, starting after w so thieves spread out.
+    Task* steal(int w) {
+        for (int k = 1; k < size(); ++k) {
+            Queue& victim = queues[(w + k) % size()];
+            std::lock_guard<std::mutex> lock(victim.m);
+            if (!victim.tasks.empty()) {
+                Task* task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    static void execute(Task* task) {
+        try {
+            task->call(task->fn);
+        } catch (...) {
+            task->error = std::current_exception();
+        }
+        task->done.store(true, std::memory_order_release);
+    }
+
+    void worker(int w) {
+        Binding bind(this, w);
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return quit || active; });
+                if (quit)
+                    return;
+            }
+            // spin on the other deques while a run() is going, park between runs
+            while (active.load(std::memory_order_relaxed)) {
+                if (Task* task = steal(w))
+                    execute(task);
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    std::vector<Queue> queues; // one per worker
+    std::vector<std::thread> workers;
+
+    std::mutex m;
+    std::condition_variable wake; // a run started, or quit
+    std::atomic<bool> active{false};
+    bool quit = false;
+};
@@ -3,106 +3,110 @@
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
-#include <thread> 
+#include <thread>
+#include <algorithm>
+#include <string>
+
+#include "parallel_merge_sort.h"
 
 using namespace std;
 
-const int THRESHOLD = 10000; 
-
-// Merge function to merge two halves
-void merge(vector<int>& arr, int left, int mid, int right) {
-    int n1 = mid - left + 1;
-    int n2 = right - mid;
-
-    vector<int> L(n1), R(n2);
-    
-    for (int i = 0; i < n1; i++)
-        L[i] = arr[left + i];
-    for (int j = 0; j < n2; j++)
-        R[j] = arr[mid + 1 + j];
-
-    int i = 0, j = 0, k = left;
-    while (i < n1 && j < n2) {
-        if (L[i] <= R[j]) {
-            arr[k] = L[i];
-            i++;
-        } else {
-            arr[k] = R[j];
-            j++;
-        }
-        k++;
-    }
-    
-    while (i < n1) {
-        arr[k] = L[i];
-        i++;
-        k++;
-    }
-    while (j < n2) {
-        arr[k] = R[j];
-        j++;
-        k++;
-    }
+// A large record sorted by one field, for the key-index benchmark
+struct Record {
+    int key;
+    long long index; // position before sorting, to check stability
+    char payload[240];
+};
+
+double seconds(chrono::high_resolution_clock::time_point start) {
+    chrono::duration<double> d = chrono::high_resolution_clock::now() - start;
+    return d.count();
 }
 
-// merge sort sequential
-void mergeSortSequential(vector<int>& arr, int left, int right) {
-    if (left < right) {
-        int mid = left + (right - left) / 2;
-        mergeSortSequential(arr, left, mid);
-        mergeSortSequential(arr, mid + 1, right);
-        merge(arr, left, mid, right);
+// Sort records by key directly and through the key index; both must be
+// stable, so equal keys stay in their original order.
+int benchmarkRecords(ForkJoinPool& pool, const vector<int>& keys) {
+    long long size = keys.size();
+    vector<Record> direct(size);
+    for (long long i = 0; i < size; i++) {
+        direct[i].key = keys[i];
+        direct[i].index = i;
     }
-}
+    vector<Record> byKey = direct;
 
-// merge sort parallel
-void mergeSort(vector<int>& arr, int left, int right) {
-    if (left < right) {
-        int mid = left + (right - left) / 2;
+    auto start = chrono::high_resolution_clock::now();
+    parallel_merge_sort(pool, direct.begin(), direct.end(), [](const Record& a, const Record& b) { return a.key < b.key; });
+    cout << "Records    " << size << " " << seconds(start) << endl;
 
-        if ((right - left) > THRESHOLD) {
-            thread leftThread(mergeSort, ref(arr), left, mid);
-            thread rightThread(mergeSort, ref(arr), mid + 1, right);
-            leftThread.join();
-            rightThread.join();
-        } else {
-            mergeSort(arr, left, mid);
-            mergeSort(arr, mid + 1, right);
-        }
+    start = chrono::high_resolution_clock::now();
+    parallel_merge_sort_by_key(pool, byKey.begin(), byKey.end(), [](const Record& r) { return r.key; });
+    cout << "By key     " << size << " " << seconds(start) << endl;
 
-        merge(arr, left, mid, right);
+    auto before = [](const Record& a, const Record& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); };
+    for (long long i = 0; i < size; i++) {
+        if (direct[i].index != byKey[i].index || (i > 0 && !before(direct[i - 1], direct[i]))) {
+            cerr << "Error: records are not stably sorted\n";
+            return 1;
+        }
     }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <array_size>\n";
+    vector<string> args;
+    Kernel kind = Kernel::Avx512;
+    bool records = false;
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--kernel" && i + 1 < argc) {
+            if (!parseKernel(argv[++i], kind)) {
+                cerr << "Error: --kernel must be scalar, avx2, avx512 or auto\n";
+                return 1;
+            }
+        } else if (string(argv[i]) == "--records") {
+            records = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() != 1 && args.size() != 2) {
+        cerr << "Usage: " << argv[0] << " <array_size> [threads] [--kernel scalar|avx2|avx512|auto] [--records]\n";
         return 1;
     }
 
-    int size = atoi(argv[1]);
+    long long size = atoll(args[0].c_str());
+    int threads = args.size() == 2 ? atoi(args[1].c_str()) : int(thread::hardware_concurrency());
+    if (threads < 1)
+        threads = 1;
+    // falls back to the best kernels this CPU supports
+    const SortKernels& kernels = sortKernels(kind);
     vector<int> original(size);
     srand(time(0));
-    for (int i = 0; i < size; i++) {
+    for (long long i = 0; i < size; i++) {
         original[i] = rand() % 10000;
     }
+    ForkJoinPool pool(threads);
+
+    if (records)
+        return benchmarkRecords(pool, original);
 
     // Sequential benchmark
     vector<int> seq = original;
     auto start_seq = chrono::high_resolution_clock::now();
-    mergeSortSequential(seq, 0, size - 1);
-    auto end_seq = chrono::high_resolution_clock::now();
-    chrono::duration<double> dur_seq = end_seq - start_seq;
-    cout << "Sequential " << size << " " << dur_seq.count() << endl;
+    merge_sort(seq.begin(), seq.end(), kernels);
+    double dur_seq = seconds(start_seq);
+    cout << "Sequential " << size << " " << dur_seq << endl;
 
     // Parallel benchmark
     vector<int> par = original;
     auto start_par = chrono::high_resolution_clock::now();
-    mergeSort(par, 0, size - 1);
-    auto end_par = chrono::high_resolution_clock::now();
-    chrono::duration<double> dur_par = end_par - start_par;
-    cout << "Parallel   " << size << " " << dur_par.count() << endl;
-    cout << "Speedup: " << dur_seq.count() / dur_par.count() << "x" << endl;
+    parallel_merge_sort(pool, par.begin(), par.end(), kernels);
+    double dur_par = seconds(start_par);
+    cout << "Parallel   " << size << " " << dur_par << endl;
+    cout << "Speedup: " << dur_seq / dur_par << "x" << " (" << threads << " threads, " << kernels.name << ")" << endl;
+    if (par != seq || !is_sorted(par.begin(), par.end())) {
+        cerr << "Error: parallel result differs from sequential\n";
+        return 1;
+    }
 
 
 
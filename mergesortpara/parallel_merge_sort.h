@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fork_join_pool.h"
+#include "sort_kernels.h"
+
+// Stable merge sort over random-access iterators, sequential (merge_sort) or
+// on a ForkJoinPool (parallel_merge_sort), with 64-bit sizes throughout.
+//
+//   parallel_merge_sort(pool, v.begin(), v.end());                  // operator<
+//   parallel_merge_sort(pool, v.begin(), v.end(), by_price);        // any strict weak order
+//   parallel_merge_sort(v.begin(), v.end());                        // pool of all cores for this call
+//   parallel_merge_sort(pool, ints.begin(), ints.end(), sortKernels(Kernel::Avx2));
+//   parallel_merge_sort_by_key(pool, rows.begin(), rows.end(), [](const Row& r) { return r.id; });
+//
+// The engine is the ping-pong sort of merge_sort.cpp: one scratch buffer the
+// size of the range, alternated with it between levels; above the grain both
+// halves are forked and merges are cut into co-ranked segments.
+//
+// Chosen at compile time by element type:
+// - ints in ascending order use the SIMD kernels (sort_kernels.h).
+// - Trivially copyable elements sort against uninitialized scratch memory,
+//   with no pass to set it up; any other type is first moved out into the
+//   scratch buffer and merged back.
+// - Ranges that are not contiguous (deque, ...) are moved into a vector,
+//   sorted there and moved back.
+// parallel_merge_sort calls pool.run(), so it must not be called from a task
+// already running on the same pool.
+
+namespace merge_sort_detail {
+
+using Index = std::ptrdiff_t;
+
+// Splits smaller than this are always sorted sequentially
+const Index MIN_GRAIN = 4096;
+// Aim for this many leaf tasks per worker, so stealing can even out the load
+const Index TASKS_PER_THREAD = 16;
+
+// Grain: enough leaves for every worker to steal from, but never tiny ones
+inline Index autoGrain(Index size, int threads) {
+    return std::max(MIN_GRAIN, size / (threads * TASKS_PER_THREAD));
+}
+
+// Call f(begin, end) over [begin, end) in pieces of at most grain, forked on
+// the pool; all at once without one
+template <class F>
+void parallelFor(ForkJoinPool* pool, Index begin, Index end, Index grain, const F& f) {
+    if (!pool || end - begin <= grain) {
+        f(begin, end);
+        return;
+    }
+    Index mid = begin + (end - begin) / 2;
+    pool->fork_join([&] { parallelFor(pool, begin, mid, grain, f); },
+                    [&] { parallelFor(pool, mid, end, grain, f); });
+}
+
+// Leaf sort and merge for any T under comp: insertion sort and a two-pointer
+// merge, both stable, moving elements
+template <class T, class Comp>
+struct GenericOps {
+    Comp comp;
+    Index block = 16;
+
+    bool less(const T& a, const T& b) const { return comp(a, b); }
+
+    void sortBlock(T* p, Index n) const {
+        for (Index i = 1; i < n; ++i) {
+            T x = std::move(p[i]);
+            Index j = i;
+            for (; j > 0 && comp(x, p[j - 1]); --j)
+                p[j] = std::move(p[j - 1]);
+            p[j] = std::move(x);
+        }
+    }
+
+    // on ties A goes first
+    void merge(T* A, Index n1, T* B, Index n2, T* out) const {
+        Index i = 0, j = 0;
+        while (i < n1 && j < n2)
+            *out++ = comp(B[j], A[i]) ? std::move(B[j++]) : std::move(A[i++]);
+        out = std::move(A + i, A + n1, out);
+        std::move(B + j, B + n2, out);
+    }
+};
+
+// Ascending ints: the run-time selected kernels
+struct KernelOps {
+    const SortKernels* kernels;
+    Index block;
+
+    explicit KernelOps(const SortKernels& k) : kernels(&k), block(k.block) {}
+    bool less(int a, int b) const { return a < b; }
+    void sortBlock(int* p, Index n) const { kernels->sortBlock(p, int(n)); }
+    void merge(int* A, Index n1, int* B, Index n2, int* out) const { kernels->merge(A, n1, B, n2, out); }
+};
+
+template <class T, class Ops>
+class Sorter {
+public:
+    Sorter(const Ops& ops, ForkJoinPool* pool, Index grain) : ops(ops), pool(pool), grain(grain) {}
+
+    // Sort the n elements in a, leaving the result in b if intoB and in a
+    // otherwise; the other buffer is scratch. Halves are sorted into the
+    // buffer the result does not go to and merged across, so a and b swap
+    // roles at every level and no element is copied back.
+    void sort(T* a, T* b, Index n, bool intoB) {
+        if (pool)
+            sortParallel(a, b, 0, n, intoB);
+        else
+            sortSequential(a, b, 0, n, intoB);
+    }
+
+private:
+    void sortSequential(T* a, T* b, Index begin, Index end, bool intoB) {
+        if (end - begin <= ops.block) {
+            ops.sortBlock(a + begin, end - begin);
+            if (intoB)
+                std::move(a + begin, a + end, b + begin);
+            return;
+        }
+        Index mid = begin + (end - begin) / 2;
+        sortSequential(a, b, begin, mid, !intoB);
+        sortSequential(a, b, mid, end, !intoB);
+        T* from = intoB ? a : b;
+        ops.merge(from + begin, mid - begin, from + mid, end - mid, (intoB ? b : a) + begin);
+    }
+
+    void sortParallel(T* a, T* b, Index begin, Index end, bool intoB) {
+        if (end - begin <= grain) {
+            sortSequential(a, b, begin, end, intoB);
+            return;
+        }
+        Index mid = begin + (end - begin) / 2;
+        pool->fork_join([&] { sortParallel(a, b, begin, mid, !intoB); },
+                        [&] { sortParallel(a, b, mid, end, !intoB); });
+        parallelMerge(intoB ? a : b, intoB ? b : a, begin, mid, end);
+    }
+
+    // Merge path co-rank: how many of the first k outputs of the stable merge
+    // of A (m elements) and B (n elements) come from A. That is the smallest i
+    // with B[k - i - 1] < A[i], found by binary search along diagonal k.
+    Index coRank(Index k, const T* A, Index m, const T* B, Index n) const {
+        Index lo = std::max<Index>(0, k - n), hi = std::min(k, m);
+        while (lo < hi) {
+            Index i = lo + (hi - lo) / 2;
+            if (ops.less(B[k - i - 1], A[i]))
+                hi = i;
+            else
+                lo = i + 1;
+        }
+        return lo;
+    }
+
+    // Merge of from[begin, mid) and from[mid, end) into to: the output is cut
+    // into segments of at most grain elements, and co-ranking each segment's
+    // start finds its inputs, so every segment is merged independently. All
+    // the cuts are found before any segment moves its elements out.
+    void parallelMerge(T* from, T* to, Index begin, Index mid, Index end) {
+        T* A = from + begin;
+        T* B = from + mid;
+        Index m = mid - begin, n = end - mid;
+        Index segments = (m + n + grain - 1) / grain;
+        std::vector<Index> cut(segments + 1);
+        for (Index s = 0; s <= segments; ++s)
+            cut[s] = coRank(std::min(s * grain, m + n), A, m, B, n);
+        parallelFor(pool, 0, segments, 1, [&](Index s0, Index s1) {
+            for (Index s = s0; s < s1; ++s) {
+                Index k0 = s * grain, k1 = std::min(k0 + grain, m + n);
+                Index i = cut[s], iEnd = cut[s + 1];
+                ops.merge(A + i, iEnd - i, B + (k0 - i), (k1 - iEnd) - (k0 - i), to + begin + k0);
+            }
+        });
+    }
+
+    Ops ops;
+    ForkJoinPool* pool;
+    Index grain;
+};
+
+struct FreeScratch {
+    template <class T>
+    void operator()(T* p) const {
+        std::allocator<T>().deallocate(p, n);
+    }
+    std::size_t n;
+};
+
+// Sort the n elements at data with ops, on pool if there is one
+template <class T, class Ops>
+void sortWith(ForkJoinPool* pool, T* data, Index n, const Ops& ops) {
+    Sorter<T, Ops> sorter(ops, pool, pool ? autoGrain(n, pool->size()) : n);
+    auto run = [&](const auto& f) {
+        if (pool)
+            pool->run(f);
+        else
+            f();
+    };
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        // nothing to construct: the sort only ever assigns into scratch
+        std::unique_ptr<T, FreeScratch> aux(std::allocator<T>().allocate(n), FreeScratch{std::size_t(n)});
+        run([&] { sorter.sort(data, aux.get(), n, false); });
+    } else {
+        std::vector<T> aux(std::make_move_iterator(data), std::make_move_iterator(data + n));
+        run([&] { sorter.sort(aux.data(), data, n, true); });
+    }
+}
+
+template <class It>
+constexpr bool isContiguous() {
+    using T = typename std::iterator_traits<It>::value_type;
+    return std::is_pointer_v<It> ||
+           (!std::is_same_v<T, bool> && std::is_same_v<It, typename std::vector<T>::iterator>);
+}
+
+template <class Comp>
+constexpr bool isAscending() {
+    return std::is_same_v<Comp, std::less<>> || std::is_same_v<Comp, std::less<int>>;
+}
+
+template <class It, class Comp>
+void sortRange(ForkJoinPool* pool, It first, It last, Comp comp) {
+    using T = typename std::iterator_traits<It>::value_type;
+    Index n = last - first;
+    if (n < 2)
+        return;
+    if constexpr (!isContiguous<It>()) {
+        std::vector<T> tmp(std::make_move_iterator(first), std::make_move_iterator(last));
+        sortRange(pool, tmp.begin(), tmp.end(), comp);
+        std::move(tmp.begin(), tmp.end(), first);
+    } else if constexpr (std::is_same_v<T, int> && isAscending<Comp>()) {
+        sortWith(pool, &*first, n, KernelOps(sortKernels(Kernel::Avx512)));
+    } else {
+        sortWith(pool, &*first, n, GenericOps<T, Comp>{comp});
+    }
+}
+
+template <class It>
+void sortInts(ForkJoinPool* pool, It first, It last, const SortKernels& kernels) {
+    static_assert(isContiguous<It>() && std::is_same_v<typename std::iterator_traits<It>::value_type, int>,
+                  "explicit kernels sort contiguous ints");
+    if (last - first >= 2)
+        sortWith(pool, &*first, last - first, KernelOps(kernels));
+}
+
+// Sort (key, index) pairs, then permute the records in place along the cycles
+// of the sorted indices: each record moves once, plus one held per cycle
+template <class It, class KeyFn, class Comp>
+void sortByKey(ForkJoinPool* pool, It first, It last, KeyFn key, Comp comp) {
+    using T = typename std::iterator_traits<It>::value_type;
+    using K = std::decay_t<std::invoke_result_t<KeyFn&, const T&>>;
+    Index n = last - first;
+    if (n < 2)
+        return;
+    const Index grain = pool ? autoGrain(n, pool->size()) : n;
+    auto run = [&](const auto& f) {
+        if (pool)
+            pool->run(f);
+        else
+            f();
+    };
+
+    std::vector<std::pair<K, Index>> order(n);
+    run([&] {
+        parallelFor(pool, 0, n, grain, [&](Index b, Index e) {
+            for (Index i = b; i < e; ++i)
+                order[i] = {key(first[i]), i};
+        });
+    });
+    // equal keys keep index order, so the records stay stable
+    sortRange(pool, order.begin(), order.end(),
+              [&](const std::pair<K, Index>& a, const std::pair<K, Index>& b) { return comp(a.first, b.first); });
+
+    // Record i belongs at the position of order[i]'s index: follow each cycle
+    // of that permutation, holding only its first record aside, and mark
+    // placed positions by pointing their index at themselves.
+    for (Index i = 0; i < n; ++i) {
+        if (order[i].second == i)
+            continue;
+        T held = std::move(first[i]);
+        Index j = i;
+        while (true) {
+            Index from = order[j].second;
+            order[j].second = j;
+            if (from == i) {
+                first[j] = std::move(held);
+                break;
+            }
+            first[j] = std::move(first[from]);
+            j = from;
+        }
+    }
+}
+
+} // namespace merge_sort_detail
+
+template <class It, class Comp = std::less<>>
+void merge_sort(It first, It last, Comp comp = Comp()) {
+    merge_sort_detail::sortRange(nullptr, first, last, comp);
+}
+
+template <class It>
+void merge_sort(It first, It last, const SortKernels& kernels) {
+    merge_sort_detail::sortInts(nullptr, first, last, kernels);
+}
+
+template <class It, class Comp = std::less<>>
+void parallel_merge_sort(ForkJoinPool& pool, It first, It last, Comp comp = Comp()) {
+    merge_sort_detail::sortRange(&pool, first, last, comp);
+}
+
+template <class It>
+void parallel_merge_sort(ForkJoinPool& pool, It first, It last, const SortKernels& kernels) {
+    merge_sort_detail::sortInts(&pool, first, last, kernels);
+}
+
+template <class It, class Comp = std::less<>>
+void parallel_merge_sort(It first, It last, Comp comp = Comp()) {
+    ForkJoinPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    parallel_merge_sort(pool, first, last, comp);
+}
+
+// Key-index sort for large records: sorts (key(record), index) pairs and
+// then permutes the records in place, moving each once instead of at every
+// level and with no record-sized buffer.
+// Stable; comp orders keys.
+template <class It, class KeyFn, class Comp = std::less<>>
+void parallel_merge_sort_by_key(ForkJoinPool& pool, It first, It last, KeyFn key, Comp comp = Comp()) {
+    merge_sort_detail::sortByKey(&pool, first, last, key, comp);
+}
+
+template <class It, class KeyFn, class Comp = std::less<>>
+void parallel_merge_sort_by_key(It first, It last, KeyFn key, Comp comp = Comp()) {
+    ForkJoinPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    parallel_merge_sort_by_key(pool, first, last, key, comp);
+}
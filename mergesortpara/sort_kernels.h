@@ -0,0 +1,315 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <climits>
+#include <cstddef>
+#include <string>
+
+// Leaf sort and merge kernels for the merge sort, picked at run time.
+//
+// The scalar kernels are the original path: recursion down to single
+// elements and a branchy two-pointer merge. The SIMD kernels stop the
+// recursion at blocks of two vectors, sorted in registers by a bitonic
+// sorting network, and merge with a vectorized bitonic merge that emits one
+// vector per step, always loading the next vector from the input whose head
+// is smaller. They are compiled with per-function target attributes, so the
+// program builds without -mavx2 and only runs them where the CPU has them.
+
+enum class Kernel { Scalar, Avx2, Avx512 };
+
+struct SortKernels {
+    Kernel kind;
+    const char* name;
+    // runs of up to block elements are sorted by sortBlock instead of recursing
+    int block;
+    void (*sortBlock)(int* p, int n);
+    // merge sorted A (n1 elements) and B (n2) into out
+    void (*merge)(const int* A, std::ptrdiff_t n1, const int* B, std::ptrdiff_t n2, int* out);
+};
+
+namespace scalar {
+
+inline void sortBlock(int*, int) {}
+
+inline void merge(const int* A, std::ptrdiff_t n1, const int* B, std::ptrdiff_t n2, int* out) {
+    std::ptrdiff_t i = 0, j = 0, k = 0;
+    while (i < n1 && j < n2) {
+        if (A[i] <= B[j]) {
+            out[k] = A[i];
+            i++;
+        } else {
+            out[k] = B[j];
+            j++;
+        }
+        k++;
+    }
+
+    while (i < n1) {
+        out[k] = A[i];
+        i++;
+        k++;
+    }
+    while (j < n2) {
+        out[k] = B[j];
+        j++;
+        k++;
+    }
+}
+
+// Finish a vector merge: C (the last vector of output, sorted) with what is
+// left of A and B
+inline void merge3(const int* C, int nc, const int* A, std::ptrdiff_t na, const int* B, std::ptrdiff_t nb, int* out) {
+    std::ptrdiff_t c = 0, a = 0, b = 0;
+    while (c < nc) {
+        if (a < na && A[a] <= C[c] && (b >= nb || A[a] <= B[b]))
+            *out++ = A[a++];
+        else if (b < nb && B[b] < C[c])
+            *out++ = B[b++];
+        else
+            *out++ = C[c++];
+    }
+    merge(A + a, na - a, B + b, nb - b, out);
+}
+
+} // namespace scalar
+
+// Lanes that keep the larger value in the compare-exchange of lanes i and
+// i ^ j, in the bitonic network stage that builds sorted blocks of k lanes
+// (ascending and descending in turn; k = lanes sorts the whole vector).
+constexpr unsigned maxLanes(int lanes, int j, int k) {
+    unsigned mask = 0;
+    for (int i = 0; i < lanes; ++i)
+        if (((i & j) != 0) != ((i & k) != 0))
+            mask |= 1u << i;
+    return mask;
+}
+
+namespace avx2 {
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// compare-exchange lanes i and i ^ J; lanes in Max keep the larger value
+template <int J, unsigned Max>
+AVX2_TARGET inline __m256i exchange(__m256i v) {
+    __m256i p;
+    if constexpr (J == 4)
+        p = _mm256_permute2x128_si256(v, v, 0x01);
+    else if constexpr (J == 2)
+        p = _mm256_shuffle_epi32(v, 0x4E);
+    else
+        p = _mm256_shuffle_epi32(v, 0xB1);
+    return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), Max);
+}
+
+// sort a bitonic vector
+AVX2_TARGET inline __m256i clean(__m256i v) {
+    v = exchange<4, maxLanes(8, 4, 8)>(v);
+    v = exchange<2, maxLanes(8, 2, 8)>(v);
+    return exchange<1, maxLanes(8, 1, 8)>(v);
+}
+
+// bitonic sorting network over the 8 lanes
+AVX2_TARGET inline __m256i sort(__m256i v) {
+    v = exchange<1, maxLanes(8, 1, 2)>(v);
+    v = exchange<2, maxLanes(8, 2, 4)>(v);
+    v = exchange<1, maxLanes(8, 1, 4)>(v);
+    return clean(v);
+}
+
+// sorted a and b: a gets the lower 8 of the 16, b the upper 8, both sorted
+AVX2_TARGET inline void merge(__m256i& a, __m256i& b) {
+    __m256i r = _mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    b = clean(_mm256_max_epi32(a, r));
+    a = clean(_mm256_min_epi32(a, r));
+}
+
+// lanes [0, n)
+AVX2_TARGET inline __m256i mask(int n) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+// p's lanes in m, INT_MAX in the rest so the padding sorts to the end
+AVX2_TARGET inline __m256i load(const int* p, __m256i m) {
+    return _mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), _mm256_maskload_epi32(p, m), m);
+}
+
+AVX2_TARGET inline void sortBlock(int* p, int n) {
+    __m256i m0 = mask(n), m1 = mask(n - 8);
+    __m256i a = sort(load(p, m0)), b = sort(load(p + 8, m1));
+    merge(a, b);
+    _mm256_maskstore_epi32(p, m0, a);
+    _mm256_maskstore_epi32(p + 8, m1, b);
+}
+
+AVX2_TARGET inline void mergeRuns(const int* A, std::ptrdiff_t n1, const int* B, std::ptrdiff_t n2, int* out) {
+    const int W = 8;
+    if (n1 < W || n2 < W) {
+        scalar::merge(A, n1, B, n2, out);
+        return;
+    }
+    __m256i carry = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(A));
+    std::ptrdiff_t i = W, j = 0, k = 0;
+    while (true) {
+        const int* next;
+        if (i < n1 && (j >= n2 || A[i] <= B[j])) {
+            if (i + W > n1)
+                break;
+            next = A + i;
+            i += W;
+        } else if (j < n2) {
+            if (j + W > n2)
+                break;
+            next = B + j;
+            j += W;
+        } else {
+            break;
+        }
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(next));
+        merge(carry, v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), carry);
+        k += W;
+        carry = v;
+    }
+    int rest[W];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rest), carry);
+    scalar::merge3(rest, W, A + i, n1 - i, B + j, n2 - j, out + k);
+}
+
+} // namespace avx2
+
+// GCC 12's AVX-512 shuffles start from a deliberately undefined vector, which
+// -Wall reports as uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace avx512 {
+
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+template <int J, unsigned Max>
+AVX512_TARGET inline __m512i exchange(__m512i v) {
+    __m512i p;
+    if constexpr (J == 8)
+        p = _mm512_shuffle_i32x4(v, v, 0x4E);
+    else if constexpr (J == 4)
+        p = _mm512_shuffle_i32x4(v, v, 0xB1);
+    else if constexpr (J == 2)
+        p = _mm512_shuffle_epi32(v, _MM_PERM_BADC);
+    else
+        p = _mm512_shuffle_epi32(v, _MM_PERM_CDAB);
+    return _mm512_mask_blend_epi32(__mmask16(Max), _mm512_min_epi32(v, p), _mm512_max_epi32(v, p));
+}
+
+AVX512_TARGET inline __m512i clean(__m512i v) {
+    v = exchange<8, maxLanes(16, 8, 16)>(v);
+    v = exchange<4, maxLanes(16, 4, 16)>(v);
+    v = exchange<2, maxLanes(16, 2, 16)>(v);
+    return exchange<1, maxLanes(16, 1, 16)>(v);
+}
+
+AVX512_TARGET inline __m512i sort(__m512i v) {
+    v = exchange<1, maxLanes(16, 1, 2)>(v);
+    v = exchange<2, maxLanes(16, 2, 4)>(v);
+    v = exchange<1, maxLanes(16, 1, 4)>(v);
+    v = exchange<4, maxLanes(16, 4, 8)>(v);
+    v = exchange<2, maxLanes(16, 2, 8)>(v);
+    v = exchange<1, maxLanes(16, 1, 8)>(v);
+    return clean(v);
+}
+
+AVX512_TARGET inline void merge(__m512i& a, __m512i& b) {
+    __m512i r = _mm512_permutexvar_epi32(_mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), b);
+    b = clean(_mm512_max_epi32(a, r));
+    a = clean(_mm512_min_epi32(a, r));
+}
+
+AVX512_TARGET inline __mmask16 mask(int n) {
+    return n <= 0 ? 0 : n >= 16 ? 0xFFFF : __mmask16((1u << n) - 1);
+}
+
+AVX512_TARGET inline void sortBlock(int* p, int n) {
+    __mmask16 m0 = mask(n), m1 = mask(n - 16);
+    __m512i pad = _mm512_set1_epi32(INT_MAX);
+    __m512i a = sort(_mm512_mask_loadu_epi32(pad, m0, p));
+    __m512i b = sort(_mm512_mask_loadu_epi32(pad, m1, p + 16));
+    merge(a, b);
+    _mm512_mask_storeu_epi32(p, m0, a);
+    _mm512_mask_storeu_epi32(p + 16, m1, b);
+}
+
+AVX512_TARGET inline void mergeRuns(const int* A, std::ptrdiff_t n1, const int* B, std::ptrdiff_t n2, int* out) {
+    const int W = 16;
+    if (n1 < W || n2 < W) {
+        scalar::merge(A, n1, B, n2, out);
+        return;
+    }
+    __m512i carry = _mm512_loadu_si512(A);
+    std::ptrdiff_t i = W, j = 0, k = 0;
+    while (true) {
+        const int* next;
+        if (i < n1 && (j >= n2 || A[i] <= B[j])) {
+            if (i + W > n1)
+                break;
+            next = A + i;
+            i += W;
+        } else if (j < n2) {
+            if (j + W > n2)
+                break;
+            next = B + j;
+            j += W;
+        } else {
+            break;
+        }
+        __m512i v = _mm512_loadu_si512(next);
+        merge(carry, v);
+        _mm512_storeu_si512(out + k, carry);
+        k += W;
+        carry = v;
+    }
+    int rest[W];
+    _mm512_storeu_si512(rest, carry);
+    scalar::merge3(rest, W, A + i, n1 - i, B + j, n2 - j, out + k);
+}
+
+} // namespace avx512
+
+#pragma GCC diagnostic pop
+
+inline bool kernelSupported(Kernel kind) {
+    switch (kind) {
+    case Kernel::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    case Kernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return true;
+    }
+}
+
+// The kernels for kind, or for the best kind below it this CPU supports
+inline const SortKernels& sortKernels(Kernel kind) {
+    static const SortKernels table[] = {
+        {Kernel::Scalar, "scalar", 1, scalar::sortBlock, scalar::merge},
+        {Kernel::Avx2, "avx2", 16, avx2::sortBlock, avx2::mergeRuns},
+        {Kernel::Avx512, "avx512", 32, avx512::sortBlock, avx512::mergeRuns},
+    };
+    int k = int(kind);
+    while (k > 0 && !kernelSupported(Kernel(k)))
+        k--;
+    return table[k];
+}
+
+// "scalar", "avx2", "avx512", or "auto" for the best the CPU supports
+inline bool parseKernel(const std::string& name, Kernel& kind) {
+    if (name == "scalar")
+        kind = Kernel::Scalar;
+    else if (name == "avx2")
+        kind = Kernel::Avx2;
+    else if (name == "avx512" || name == "auto")
+        kind = Kernel::Avx512;
+    else
+        return false;
+    return true;
+}